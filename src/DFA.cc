@@ -3,9 +3,13 @@
 #include "zeek/zeek-config.h"
 
 #include "zeek/DFA.h"
+
+#include <algorithm>
+
 #include "zeek/EquivClass.h"
 #include "zeek/Desc.h"
 #include "zeek/Hash.h"
+#include "zeek/NetVar.h"
 
 namespace zeek::detail {
 
@@ -20,6 +24,8 @@ DFA_State::DFA_State(int arg_state_num, const EquivClass* ec,
 	nfa_states = arg_nfa_states;
 	accept = arg_accept;
 	mark = nullptr;
+	used = false;
+	evicted = false;
 
 	SymPartition(ec);
 
@@ -34,7 +40,7 @@ DFA_State::~DFA_State()
 	delete [] xtions;
 	delete nfa_states;
 	delete accept;
-	delete meta_ec;
+	delete [] meta_rep;
 	}
 
 void DFA_State::AddXtion(int sym, DFA_State* next_state)
@@ -47,7 +53,9 @@ void DFA_State::SymPartition(const EquivClass* ec)
 	// Partitioning is done by creating equivalence classes for those
 	// characters which have out-transitions from the given state.  Thus
 	// we are really creating equivalence classes of equivalence classes.
-	meta_ec = new EquivClass(ec->NumClasses());
+	// We only keep their representatives, as that's all ComputeXtion()
+	// needs.
+	EquivClass* meta_ec = new EquivClass(ec->NumClasses());
 
 	assert(nfa_states);
 	for ( int i = 0; i < nfa_states->length(); ++i )
@@ -73,11 +81,18 @@ void DFA_State::SymPartition(const EquivClass* ec)
 		}
 
 	meta_ec->BuildECs();
+
+	meta_rep = new uint16_t[num_sym];
+
+	for ( int i = 0; i < num_sym; ++i )
+		meta_rep[i] = meta_ec->EquivRep(i);
+
+	delete meta_ec;
 	}
 
 DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 	{
-	int equiv_sym = meta_ec->EquivRep(sym);
+	int equiv_sym = meta_rep[sym];
 	if ( xtions[equiv_sym] != DFA_UNCOMPUTED_STATE_PTR )
 		{
 		AddXtion(sym, xtions[equiv_sym]);
@@ -87,12 +102,14 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 	const EquivClass* ec = machine->EC();
 
 	DFA_State* next_d;
+	bool new_state = false;
 
 	NFA_state_list* ns = SymFollowSet(equiv_sym, ec);
 	if ( ns->length() > 0 )
 		{
 		NFA_state_list* state_set = epsilon_closure(ns);
-		if ( ! machine->StateSetToDFA_State(state_set, next_d, ec) )
+		new_state = machine->StateSetToDFA_State(state_set, next_d, ec);
+		if ( ! new_state )
 			delete state_set;
 		}
 	else
@@ -105,7 +122,14 @@ DFA_State* DFA_State::ComputeXtion(int sym, DFA_Machine* machine)
 	if ( sym != equiv_sym )
 		AddXtion(sym, next_d);
 
-	return xtions[sym];
+	if ( new_state && dfa_state_cache_budget &&
+	     machine->dfa_state_cache->Mem() > dfa_state_cache_budget )
+		// Evict a bit more than needed so that we don't have
+		// to do it again with the next state.
+		machine->dfa_state_cache->Evict(dfa_state_cache_budget / 4 * 3,
+		                                {machine->start_state, this, next_d});
+
+	return next_d;
 	}
 
 void DFA_State::AppendIfNew(int sym, int_list* sym_list)
@@ -287,12 +311,15 @@ unsigned int DFA_State::Size()
 		+ util::pad_size(sizeof(DFA_State*) * num_sym)
 		+ (accept ? util::pad_size(sizeof(int) * accept->size()) : 0)
 		+ (nfa_states ? util::pad_size(sizeof(NFA_State*) * nfa_states->length()) : 0)
-		+ (meta_ec ? meta_ec->Size() : 0);
+		+ util::pad_size(sizeof(uint16_t) * num_sym);
 	}
 
 DFA_State_Cache::DFA_State_Cache()
 	{
 	hits = misses = 0;
+	evictions = 0;
+	evicted_mem = 0;
+	mem = 0;
 	}
 
 DFA_State_Cache::~DFA_State_Cache()
@@ -304,6 +331,14 @@ DFA_State_Cache::~DFA_State_Cache()
 		}
 
 	states.clear();
+
+	for ( auto d : detached )
+		Unref(d);
+	}
+
+uint64_t DFA_State_Cache::StateMem(DFA_State* s)
+	{
+	return util::pad_size(s->Size()) + padded_sizeof(*s);
 	}
 
 DFA_State* DFA_State_Cache::Lookup(const NFA_state_list& nfas, DigestStr* digest)
@@ -354,9 +389,95 @@ DFA_State* DFA_State_Cache::Lookup(const NFA_state_list& nfas, DigestStr* digest
 DFA_State* DFA_State_Cache::Insert(DFA_State* state, DigestStr digest)
 	{
 	states.emplace(std::move(digest), state);
+	mem += StateMem(state);
 	return state;
 	}
 
+void DFA_State_Cache::Evict(uint64_t target, std::initializer_list<const DFA_State*> pinned)
+	{
+	// Detached states that only we still refer to can go now.
+	for ( size_t i = 0; i < detached.size(); )
+		{
+		if ( detached[i]->RefCnt() > 1 )
+			{
+			++i;
+			continue;
+			}
+
+		Unref(detached[i]);
+		detached[i] = detached.back();
+		detached.pop_back();
+		}
+
+	// This approximates LRU in the way CLOCK does: the first pass only
+	// takes states that haven't been used since the last eviction, the
+	// second one whatever it still needs.
+	std::vector<DFA_State*> victims;
+
+	for ( int pass = 0; pass < 2 && mem > target; ++pass )
+		{
+		for ( auto i = states.begin(); i != states.end() && mem > target; )
+			{
+			DFA_State* s = i->second;
+
+			if ( (pass == 0 && s->used) ||
+			     std::find(pinned.begin(), pinned.end(), s) != pinned.end() )
+				{
+				++i;
+				continue;
+				}
+
+			s->evicted = true;
+			mem -= StateMem(s);
+			victims.push_back(s);
+			i = states.erase(i);
+			}
+		}
+
+	for ( const auto& entry : states )
+		entry.second->used = false;
+
+	if ( victims.empty() )
+		return;
+
+	size_t num_detached = detached.size();
+
+	for ( auto v : victims )
+		{
+		++evictions;
+		evicted_mem += StateMem(v);
+
+		if ( v->RefCnt() > 1 )
+			detached.push_back(v);
+		}
+
+	// Nothing may point to an evicted state anymore. Note that this
+	// includes the transitions of the ones we detach.
+	auto sweep = [](DFA_State* s)
+		{
+		for ( int i = 0; i < s->num_sym; ++i )
+			{
+			DFA_State* x = s->xtions[i];
+
+			if ( x && x != DFA_UNCOMPUTED_STATE_PTR && x->evicted )
+				s->xtions[i] = DFA_UNCOMPUTED_STATE_PTR;
+			}
+		};
+
+	for ( const auto& entry : states )
+		sweep(entry.second);
+
+	for ( auto d : detached )
+		sweep(d);
+
+	for ( size_t i = num_detached; i < detached.size(); ++i )
+		detached[i]->evicted = false;
+
+	for ( auto v : victims )
+		if ( v->evicted )
+			Unref(v);
+	}
+
 void DFA_State_Cache::GetStats(Stats* s)
 	{
 	s->dfa_states = 0;
@@ -366,6 +487,8 @@ void DFA_State_Cache::GetStats(Stats* s)
 	s->mem = 0;
 	s->hits = hits;
 	s->misses = misses;
+	s->evictions = evictions;
+	s->evicted_mem = evicted_mem;
 
 	for ( const auto& state : states )
 		{
@@ -373,7 +496,7 @@ void DFA_State_Cache::GetStats(Stats* s)
 		++s->dfa_states;
 		s->nfa_states += e->NFAStateNum();
 		e->Stats(&s->computed, &s->uncomputed);
-		s->mem += util::pad_size(e->Size()) + padded_sizeof(*e);
+		s->mem += StateMem(e);
 		}
 	}
 
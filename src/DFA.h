@@ -5,8 +5,10 @@
 
 #include <assert.h>
 #include <sys/types.h> // for u_char
+#include <initializer_list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "zeek/NFA.h"
 #include "zeek/RE.h" // for typedef AcceptingSet
@@ -44,9 +46,6 @@ public:
 	DFA_State* Mark() const		{ return mark; }
 	void ClearMarks();
 
-	// Returns the equivalence classes of ec's corresponding to this state.
-	const EquivClass* MetaECs() const	{ return meta_ec; }
-
 	void Describe(ODesc* d) const override;
 	void Dump(FILE* f, DFA_Machine* m);
 	void Stats(unsigned int* computed, unsigned int* uncomputed);
@@ -65,9 +64,19 @@ protected:
 
 	AcceptingSet* accept;
 	NFA_state_list* nfa_states;
-	EquivClass* meta_ec;	// which ec's make same transition
+
+	// For each ec, the ec that makes the same transition from this
+	// state and whose transition gets computed in its place.
+	uint16_t* meta_rep;
+
 	DFA_State* mark;
 
+	// Set when the state gets used, cleared by the cache's evictions.
+	bool used;
+
+	// Set while the cache evicts the state.
+	bool evicted;
+
 	static unsigned int transition_counter;	// see Xtion()
 };
 
@@ -86,6 +95,22 @@ public:
 
 	int NumEntries() const	{ return states.size(); }
 
+	// Number of bytes used by the cached states.
+	uint64_t Mem() const	{ return mem; }
+
+	// Evicts states until at most target bytes remain, starting with
+	// those that haven't been used since the last eviction.  Transitions
+	// into evicted states revert to uncomputed, so they get recomputed
+	// when needed again.  States in pinned, and states which someone
+	// else still holds a reference to, are kept alive; the latter
+	// leave the cache but stay usable.
+	//
+	// With sig_matcher_threads, this runs on whichever thread matches
+	// against the DFA, so the states' destructors, including plugins'
+	// HookBroObjDtor() for them, may run off the main thread. They only
+	// touch the state itself, which no other thread uses at the time.
+	void Evict(uint64_t target, std::initializer_list<const DFA_State*> pinned);
+
 	struct Stats {
 		// Sum of all NFA states
 		unsigned int nfa_states;
@@ -95,16 +120,28 @@ public:
 		unsigned int mem;
 		unsigned int hits;
 		unsigned int misses;
+		uint64_t evictions;	// # states evicted
+		uint64_t evicted_mem;	// # bytes released by evictions
 	};
 
 	void GetStats(Stats* s);
 
 private:
+	static uint64_t StateMem(DFA_State* s);
+
 	int hits;	// Statistics
 	int misses;
+	uint64_t evictions;
+	uint64_t evicted_mem;
+	uint64_t mem;
 
 	// Hash indexed by NFA states (MD5s of them, actually).
 	std::map<DigestStr, DFA_State*> states;
+
+	// Evicted states that are still referenced from elsewhere.  Their
+	// transitions may point into the cache, so they need to be looked
+	// at when evicting more states.
+	std::vector<DFA_State*> detached;
 };
 
 class DFA_Machine : public Obj {
@@ -146,6 +183,8 @@ protected:
 
 inline DFA_State* DFA_State::Xtion(int sym, DFA_Machine* machine)
 	{
+	used = true;
+
 	if ( xtions[sym] == DFA_UNCOMPUTED_STATE_PTR )
 		return ComputeXtion(sym, machine);
 	else
@@ -133,12 +133,19 @@ public:
 	bool Failed() const		{ return failed; }
 	bool Valid() const		{ return ! failed; }
 
+	bool CanExpire() const
+		{
+		return ! (req_host && num_addrs == 0); // nothing to expire
+		}
+
+	double ExpirationTime() const	{ return creation_time + req_ttl; }
+
 	bool Expired() const
 		{
-		if ( req_host && num_addrs == 0)
-			return false; // nothing to expire
+		if ( ! CanExpire() )
+			return false;
 
-		return util::current_time() > (creation_time + req_ttl);
+		return util::current_time() > ExpirationTime();
 		}
 
 	int Type() const { return map_type; }
@@ -820,7 +827,86 @@ void DNS_Mgr::AddResult(DNS_Mgr_Request* dr, struct nb_dns_result* r)
 	if ( keep_prev )
 		delete new_dm;
 	else
+		{
 		delete prev_dm;
+		ScheduleExpiry(new_dm, dr->ReqIsTxt());
+		}
+	}
+
+// Width of the buckets that cached mappings are sorted into by their
+// expiration time.
+static constexpr double EXPIRY_BUCKET_WIDTH = 60.0;
+
+void DNS_Mgr::ScheduleExpiry(DNS_Mapping* dm, bool is_txt)
+	{
+	// Priming and forcing rely on the cache as it is.
+	if ( mode != DNS_DEFAULT || ! dm->CanExpire() )
+		return;
+
+	auto bucket = static_cast<int64_t>(dm->ExpirationTime() / EXPIRY_BUCKET_WIDTH);
+	auto& em = expiry_buckets[bucket].emplace_back();
+	em.dm = dm;
+	em.is_txt = is_txt;
+
+	if ( dm->ReqHost() )
+		em.host = dm->ReqHost();
+	else
+		em.addr = dm->ReqAddr();
+	}
+
+void DNS_Mgr::ExpireMappings()
+	{
+	auto now = static_cast<int64_t>(util::current_time() / EXPIRY_BUCKET_WIDTH);
+
+	// All mappings in buckets before the current one have expired,
+	// unless they've been replaced by newer ones.
+	while ( ! expiry_buckets.empty() && expiry_buckets.begin()->first < now )
+		{
+		for ( const auto& em : expiry_buckets.begin()->second )
+			{
+			if ( em.is_txt )
+				{
+				auto it = text_mappings.find(em.host);
+
+				if ( it != text_mappings.end() && it->second == em.dm &&
+				     em.dm->Expired() )
+					{
+					delete it->second;
+					text_mappings.erase(it);
+					}
+				}
+
+			else if ( ! em.host.empty() )
+				{
+				auto it = host_mappings.find(em.host);
+
+				// Like LookupNameInCache(), drop both address
+				// families once one has expired.
+				if ( it != host_mappings.end() &&
+				     (it->second.first == em.dm || it->second.second == em.dm) &&
+				     em.dm->Expired() )
+					{
+					delete it->second.first;
+					delete it->second.second;
+					host_mappings.erase(it);
+					}
+				}
+
+			else
+				{
+				auto it = addr_mappings.find(em.addr);
+
+				if ( it != addr_mappings.end() && it->second == em.dm &&
+				     em.dm->Expired() )
+					{
+					delete it->second;
+					addr_mappings.erase(it);
+					}
+				}
+			}
+
+		expiry_buckets.erase(expiry_buckets.begin());
+		}
 	}
 
 void DNS_Mgr::CompareMappings(DNS_Mapping* prev_dm, DNS_Mapping* new_dm)
@@ -1029,6 +1115,15 @@ const char* DNS_Mgr::LookupTextInCache(const string& name)
 	return d->names ? d->names[0] : "<\?\?\?>";
 	}
 
+size_t DNS_Mgr::AddrHash::operator()(const IPAddr& addr) const
+	{
+	// Scripts mostly look up addresses they saw in traffic, so the
+	// sender picks the keys.
+	const uint32_t* bytes;
+	int len = addr.GetBytes(&bytes);
+	return KeyedHash::Hash64(bytes, len * sizeof(uint32_t));
+	}
+
 static void resolve_lookup_cb(DNS_Mgr::LookupCallback* callback,
                               TableValPtr result)
 	{
@@ -1081,6 +1176,75 @@ void DNS_Mgr::AsyncLookupAddr(const IPAddr& host, LookupCallback* callback)
 	IssueAsyncRequests();
 	}
 
+// Collects the results of the individual lookups issued by
+// AsyncLookupAddrs().
+class BulkAddrLookup {
+public:
+	BulkAddrLookup(vector<IPAddr> arg_addrs, DNS_Mgr::BulkLookupCallback* arg_callback)
+		: addrs(std::move(arg_addrs)), names(addrs.size()),
+		  remaining(addrs.size()), callback(arg_callback)
+		{ }
+
+	~BulkAddrLookup()	{ delete callback; }
+
+	const IPAddr& Addr(size_t idx) const	{ return addrs[idx]; }
+
+	// Records the name of one address, or a timeout if null. Deletes
+	// this object after the last one.
+	void Done(size_t idx, const char* name)
+		{
+		if ( name )
+			names[idx] = name;
+
+		if ( --remaining == 0 )
+			{
+			callback->Resolved(addrs, names);
+			delete this;
+			}
+		}
+
+private:
+	vector<IPAddr> addrs;
+	vector<string> names;
+	size_t remaining;
+	DNS_Mgr::BulkLookupCallback* callback;
+};
+
+class BulkAddrLookupCallback : public DNS_Mgr::LookupCallback {
+public:
+	BulkAddrLookupCallback(BulkAddrLookup* arg_bulk, size_t arg_idx)
+		: bulk(arg_bulk), idx(arg_idx)
+		{ }
+
+	void Resolved(const char* name) override	{ bulk->Done(idx, name); }
+	void Timeout() override	{ bulk->Done(idx, nullptr); }
+
+private:
+	BulkAddrLookup* bulk;
+	size_t idx;
+};
+
+void DNS_Mgr::AsyncLookupAddrs(vector<IPAddr> addrs, BulkLookupCallback* callback)
+	{
+	if ( addrs.empty() )
+		{
+		callback->Resolved(addrs, {});
+		delete callback;
+		return;
+		}
+
+	size_t n = addrs.size();
+	auto* bulk = new BulkAddrLookup(std::move(addrs), callback);
+
+	// Lookups answered from the cache finish right away, so the last
+	// one may delete bulk.
+	for ( size_t i = 0; i < n; ++i )
+		{
+		IPAddr addr = bulk->Addr(i);
+		AsyncLookupAddr(addr, new BulkAddrLookupCallback(bulk, i));
+		}
+	}
+
 void DNS_Mgr::AsyncLookupName(const string& name, LookupCallback* callback)
 	{
 	InitSource();
@@ -1365,19 +1529,25 @@ void DNS_Mgr::Process()
 		delete req;
 		}
 
-	if ( AnswerAvailable(0) <= 0 )
-		return;
+	ExpireMappings();
 
-	char err[NB_DNS_ERRSIZE];
-	struct nb_dns_result r;
+	// Handle all answers that have arrived, rather than one per call.
+	while ( AnswerAvailable(0) > 0 )
+		{
+		char err[NB_DNS_ERRSIZE];
+		struct nb_dns_result r;
 
-	int status = nb_dns_activity(nb_dns, &r, err);
+		int status = nb_dns_activity(nb_dns, &r, err);
 
-	if ( status < 0 )
-		reporter->Warning("NB-DNS error in DNS_Mgr::Process (%s)", err);
+		if ( status < 0 )
+			{
+			reporter->Warning("NB-DNS error in DNS_Mgr::Process (%s)", err);
+			break;
+			}
+
+		if ( status == 0 )
+			continue;
 
-	else if ( status > 0 )
-		{
 		DNS_Mgr_Request* dr = (DNS_Mgr_Request*) r.cookie;
 
 		bool do_host_timeout = true;
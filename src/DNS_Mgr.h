@@ -5,10 +5,14 @@
 #include <list>
 #include <map>
 #include <queue>
+#include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "zeek/List.h"
 #include "zeek/EventHandler.h"
+#include "zeek/Hash.h"
 #include "zeek/iosource/IOSource.h"
 #include "zeek/IPAddr.h"
 #include "zeek/util.h"
@@ -89,6 +93,23 @@ public:
 	void AsyncLookupName(const std::string& name, LookupCallback* callback);
 	void AsyncLookupNameText(const std::string& name, LookupCallback* callback);
 
+	// Support for resolving a number of addresses at once.
+	class BulkLookupCallback {
+	public:
+		virtual ~BulkLookupCallback()	{ }
+
+		// Called once all lookups have finished. The names are in
+		// the order of the addresses passed to AsyncLookupAddrs(),
+		// with an empty name for lookups that timed out.
+		virtual void Resolved(const std::vector<IPAddr>& addrs,
+		                      const std::vector<std::string>& names) = 0;
+	};
+
+	// Looks up the names of all the addresses, issuing requests for
+	// those not in the cache. Takes ownership of the callback, which
+	// may run before this returns if all names are known already.
+	void AsyncLookupAddrs(std::vector<IPAddr> addrs, BulkLookupCallback* callback);
+
 	struct Stats {
 		unsigned long requests;	// These count only async requests.
 		unsigned long successful;
@@ -119,9 +140,16 @@ protected:
 	ListValPtr AddrListDelta(ListVal* al1, ListVal* al2);
 	void DumpAddrList(FILE* f, ListVal* al);
 
-	typedef std::map<std::string, std::pair<DNS_Mapping*, DNS_Mapping*> > HostMap;
-	typedef std::map<IPAddr, DNS_Mapping*> AddrMap;
-	typedef std::map<std::string, DNS_Mapping*> TextMap;
+	struct AddrHash {
+		size_t operator()(const IPAddr& addr) const;
+	};
+
+	// Names may come from replies or from traffic, like the addresses,
+	// so all caches use keyed hashes.
+	typedef std::unordered_map<std::string, std::pair<DNS_Mapping*, DNS_Mapping*>,
+	                           KeyedStringHash> HostMap;
+	typedef std::unordered_map<IPAddr, DNS_Mapping*, AddrHash> AddrMap;
+	typedef std::unordered_map<std::string, DNS_Mapping*, KeyedStringHash> TextMap;
 	void LoadCache(FILE* f);
 	void Save(FILE* f, const AddrMap& m);
 	void Save(FILE* f, const HostMap& m);
@@ -134,6 +162,11 @@ protected:
 	// Issue as many queued async requests as slots are available.
 	void IssueAsyncRequests();
 
+	// Remembers when a newly cached mapping expires, and removes
+	// mappings that have expired since the last call.
+	void ScheduleExpiry(DNS_Mapping* dm, bool is_txt);
+	void ExpireMappings();
+
 	// Finish the request if we have a result.  If not, time it out if
 	// requested.
 	void CheckAsyncAddrRequest(const IPAddr& addr, bool timeout);
@@ -214,13 +247,13 @@ protected:
 
 	};
 
-	typedef std::map<IPAddr, AsyncRequest*> AsyncRequestAddrMap;
+	typedef std::unordered_map<IPAddr, AsyncRequest*, AddrHash> AsyncRequestAddrMap;
 	AsyncRequestAddrMap asyncs_addrs;
 
-	typedef std::map<std::string, AsyncRequest*> AsyncRequestNameMap;
+	typedef std::unordered_map<std::string, AsyncRequest*, KeyedStringHash> AsyncRequestNameMap;
 	AsyncRequestNameMap asyncs_names;
 
-	typedef std::map<std::string, AsyncRequest*> AsyncRequestTextMap;
+	typedef std::unordered_map<std::string, AsyncRequest*, KeyedStringHash> AsyncRequestTextMap;
 	AsyncRequestTextMap asyncs_texts;
 
 	typedef std::list<AsyncRequest*> QueuedList;
@@ -238,6 +271,18 @@ protected:
 
 	int asyncs_pending;
 
+	// Cached mappings that can expire, in buckets of EXPIRY_BUCKET_WIDTH
+	// seconds by their expiration time, so that mappings nobody asks
+	// for again still get removed.
+	struct ExpiringMapping {
+		DNS_Mapping* dm; // Only compared, it may have been deleted.
+		std::string host;
+		IPAddr addr;
+		bool is_txt;
+	};
+
+	std::map<int64_t, std::vector<ExpiringMapping>> expiry_buckets;
+
 	unsigned long num_requests;
 	unsigned long successful;
 	unsigned long failed;
@@ -23,6 +23,8 @@ Discarder::Discarder()
 	check_udp = id::find_func("discarder_check_udp");
 	check_icmp = id::find_func("discarder_check_icmp");
 
+	rules_id = id::find("discard_rules");
+
 	discarder_maxlen = static_cast<int>(id::find_val("discarder_maxlen")->AsCount());
 	}
 
@@ -32,13 +34,198 @@ Discarder::~Discarder()
 
 bool Discarder::IsActive()
 	{
-	return check_ip || check_tcp || check_udp || check_icmp;
+	if ( check_ip || check_tcp || check_udp || check_icmp )
+		return true;
+
+	if ( ! rules_id )
+		return false;
+
+	// The rules may have been changed through the configuration
+	// framework, which installs a new value.
+	if ( rules_id->GetVal() != compiled_rules )
+		CompileRules();
+
+	return ! rules.empty();
+	}
+
+// Key of a port in the compiled rules' port sets.
+static inline uint32_t port_key(TransportProto proto, uint32_t port)
+	{
+	return (static_cast<uint32_t>(proto) << 16) | port;
+	}
+
+static void insert_ports(std::unordered_set<uint32_t>* ports, const TableVal* set)
+	{
+	auto lv = set->ToPureListVal();
+
+	for ( int i = 0; i < lv->Length(); ++i )
+		{
+		auto p = lv->Idx(i)->AsPortVal();
+		ports->insert(port_key(p->PortType(), p->Port()));
+		}
+	}
+
+static std::unique_ptr<PrefixTable> make_prefix_table(const TableVal* set)
+	{
+	auto pt = std::make_unique<PrefixTable>();
+	auto lv = set->ToPureListVal();
+
+	for ( int i = 0; i < lv->Length(); ++i )
+		pt->Insert(lv->Idx(i).get());
+
+	return pt;
+	}
+
+void Discarder::CompileRules()
+	{
+	compiled_rules = rules_id->GetVal();
+	rules.clear();
+
+	if ( ! compiled_rules )
+		return;
+
+	auto rv = compiled_rules->AsVectorVal();
+	rules.reserve(rv->Size());
+
+	for ( unsigned int i = 0; i < rv->Size(); ++i )
+		{
+		auto r = rv->RecordValAt(i);
+
+		if ( ! r )
+			continue;
+
+		Rule rule;
+
+		if ( auto v = r->GetField(0) )
+			rule.src_nets = make_prefix_table(v->AsTableVal());
+
+		if ( auto v = r->GetField(1) )
+			rule.dst_nets = make_prefix_table(v->AsTableVal());
+
+		if ( auto v = r->GetField(2) )
+			rule.proto = static_cast<TransportProto>(v->AsEnum());
+
+		if ( auto v = r->GetField(3) )
+			insert_ports(&rule.src_ports, v->AsTableVal());
+
+		if ( auto v = r->GetField(4) )
+			insert_ports(&rule.dst_ports, v->AsTableVal());
+
+		rule.tcp_flags = r->GetFieldOrDefault(5)->AsCount();
+		rule.tcp_flags_mask = r->GetFieldOrDefault(6)->AsCount();
+
+		rules.push_back(std::move(rule));
+		}
+	}
+
+bool Discarder::MatchRules(const IP_Hdr& ip, int len, int caplen) const
+	{
+	TransportProto proto;
+	int min_hdr_len;
+
+	switch ( ip.NextProto() ) {
+	case IPPROTO_TCP:
+		proto = TRANSPORT_TCP;
+		min_hdr_len = sizeof(struct tcphdr);
+		break;
+
+	case IPPROTO_UDP:
+		proto = TRANSPORT_UDP;
+		min_hdr_len = sizeof(struct udphdr);
+		break;
+
+	case IPPROTO_ICMP:
+	case IPPROTO_ICMPV6:
+		proto = TRANSPORT_ICMP;
+		min_hdr_len = 4;
+		break;
+
+	default:
+		proto = TRANSPORT_UNKNOWN;
+		min_hdr_len = 0;
+		break;
+	}
+
+	// Ports and TCP flags are only available for complete transport
+	// headers. Rules that need them never match other packets.
+	bool have_transport = false;
+	uint32_t src_port = 0;
+	uint32_t dst_port = 0;
+	uint32_t tcp_flags = 0;
+
+	int ip_hdr_len = ip.HdrLen();
+
+	if ( proto != TRANSPORT_UNKNOWN && ! ip.IsFragment() &&
+	     len - ip_hdr_len >= min_hdr_len && caplen - ip_hdr_len >= min_hdr_len )
+		{
+		const u_char* data = ip.Payload();
+		have_transport = true;
+
+		if ( proto == TRANSPORT_ICMP )
+			{
+			// Like for connections, the type serves as source
+			// port and the code as destination port.
+			src_port = data[0];
+			dst_port = data[1];
+			}
+		else
+			{
+			src_port = (data[0] << 8) | data[1];
+			dst_port = (data[2] << 8) | data[3];
+
+			if ( proto == TRANSPORT_TCP )
+				tcp_flags = ((const struct tcphdr*) data)->th_flags;
+			}
+		}
+
+	IPAddr src = ip.SrcAddr();
+	IPAddr dst = ip.DstAddr();
+
+	for ( const auto& r : rules )
+		{
+		if ( r.proto != TRANSPORT_UNKNOWN && r.proto != proto )
+			continue;
+
+		if ( r.src_nets && ! r.src_nets->Lookup(src, 128) )
+			continue;
+
+		if ( r.dst_nets && ! r.dst_nets->Lookup(dst, 128) )
+			continue;
+
+		if ( ! r.src_ports.empty() &&
+		     (! have_transport || ! r.src_ports.count(port_key(proto, src_port))) )
+			continue;
+
+		if ( ! r.dst_ports.empty() &&
+		     (! have_transport || ! r.dst_ports.count(port_key(proto, dst_port))) )
+			continue;
+
+		if ( r.tcp_flags_mask &&
+		     (proto != TRANSPORT_TCP || ! have_transport ||
+		      (tcp_flags & r.tcp_flags_mask) != r.tcp_flags) )
+			continue;
+
+		return true;
+		}
+
+	return false;
 	}
 
 bool Discarder::NextPacket(const std::unique_ptr<IP_Hdr>& ip, int len, int caplen)
 	{
 	bool discard_packet = false;
 
+	if ( rules_id )
+		{
+		// The rules may have been changed through the configuration
+		// framework, which installs a new value.
+		if ( rules_id->GetVal() != compiled_rules )
+			CompileRules();
+
+		if ( ! rules.empty() && MatchRules(*ip, len, caplen) )
+			return true;
+		}
+
 	if ( check_ip )
 		{
 		zeek::Args args{ip->ToPktHdrVal()};
@@ -4,30 +4,61 @@
 
 #include <sys/types.h> // for u_char
 #include <memory>
+#include <unordered_set>
+#include <vector>
 
 #include "zeek/IntrusivePtr.h"
+#include "zeek/PrefixTable.h"
 
 namespace zeek {
 
 class IP_Hdr;
 class Val;
 class Func;
+using ValPtr = IntrusivePtr<Val>;
 using FuncPtr = IntrusivePtr<Func>;
 
 namespace detail {
 
+class ID;
+using IDPtr = IntrusivePtr<ID>;
+
 class Discarder {
 public:
 	Discarder();
 	~Discarder();
 
+	/**
+	 * Returns true if there are discard rules or discarder functions, and
+	 * NextPacket() may thus discard packets. Checked for every packet, as
+	 * discard_rules can change at runtime.
+	 */
 	bool IsActive();
 
 	bool NextPacket(const std::unique_ptr<IP_Hdr>& ip, int len, int caplen);
 
 protected:
+	// An entry of discard_rules, compiled into lookup structures that
+	// can be matched without building any Vals.
+	struct Rule {
+		std::unique_ptr<PrefixTable> src_nets; // Null if any address matches.
+		std::unique_ptr<PrefixTable> dst_nets;
+		TransportProto proto = TRANSPORT_UNKNOWN; // Matches any if unknown.
+		std::unordered_set<uint32_t> src_ports; // Empty if any port matches.
+		std::unordered_set<uint32_t> dst_ports;
+		uint32_t tcp_flags = 0;
+		uint32_t tcp_flags_mask = 0;
+	};
+
 	Val* BuildData(const u_char* data, int hdrlen, int len, int caplen);
 
+	void CompileRules();
+	bool MatchRules(const IP_Hdr& ip, int len, int caplen) const;
+
+	IDPtr rules_id;
+	ValPtr compiled_rules; // The value of discard_rules that rules reflect.
+	std::vector<Rule> rules;
+
 	FuncPtr check_ip;
 	FuncPtr check_tcp;
 	FuncPtr check_udp;
@@ -1,5 +1,7 @@
 #include "zeek/EventHandler.h"
 
+#include <chrono>
+
 #include "zeek/Event.h"
 #include "zeek/Desc.h"
 #include "zeek/Func.h"
@@ -103,8 +105,24 @@ void EventHandler::Call(Args* vl, bool no_remote)
 		}
 
 	if ( local )
-		// No try/catch here; we pass exceptions upstream.
+		{
+		++call_count;
+
+		// The clock reads are only worth it if someone reports the time.
+		if ( ! detail::core_metrics )
+			{
+			// No try/catch here; we pass exceptions upstream.
+			local->Invoke(vl);
+			return;
+			}
+
+		auto start = std::chrono::steady_clock::now();
+
 		local->Invoke(vl);
+
+		call_nsecs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		}
 	}
 
 void EventHandler::NewEvent(Args* vl)
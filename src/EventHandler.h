@@ -57,6 +57,12 @@ public:
 	void SetGenerateAlways()	{ generate_always = true; }
 	bool GenerateAlways()	{ return generate_always; }
 
+	// Number of times the local handler has been invoked, and the total
+	// time spent in those invocations in seconds, including any nested
+	// event dispatching.  Reported via telemetry by CoreMetrics.
+	uint64_t CallCount() const	{ return call_count; }
+	double CallTime() const	{ return call_nsecs / 1e9; }
+
 private:
 	void NewEvent(zeek::Args* vl);	// Raise new_event() meta event.
 
@@ -67,6 +73,8 @@ private:
 	bool enabled;
 	bool error_handler;	// this handler reports error messages.
 	bool generate_always;
+	uint64_t call_count = 0;
+	uint64_t call_nsecs = 0;
 
 	std::unordered_set<std::string> auto_publish;
 };
@@ -38,6 +38,7 @@
 #include "zeek/Desc.h"
 #include "zeek/Expr.h"
 #include "zeek/Stmt.h"
+#include "zeek/SamplingProfiler.h"
 #include "zeek/Scope.h"
 #include "zeek/RunState.h"
 #include "zeek/NetVar.h"
@@ -395,6 +396,7 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 	g_frame_stack.push_back(f.get());	// used for backtracing
 	const CallExpr* call_expr = parent ? parent->GetCall() : nullptr;
 	call_stack.emplace_back(CallInfo{call_expr, this, *args});
+	sampling_profiler.EnterScript();
 
 	if ( g_trace_state.DoTrace() )
 		{
@@ -435,6 +437,7 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 			// Already reported, but now determine whether to unwind further.
 			if ( Flavor() == FUNC_FLAVOR_FUNCTION )
 				{
+				sampling_profiler.LeaveScript();
 				g_frame_stack.pop_back();
 				call_stack.pop_back();
 				// Result not set b/c exception was thrown
@@ -493,6 +496,10 @@ ValPtr ScriptFunc::Invoke(zeek::Args* args, Frame* parent) const
 		g_trace_state.LogTrace("Function return: %s\n", d.Description());
 		}
 
+	// Charge anything sampled during the last statement while its frame
+	// is still around.
+	sampling_profiler.Sample();
+	sampling_profiler.LeaveScript();
 	g_frame_stack.pop_back();
 
 	return result;
@@ -1048,6 +1055,7 @@ void init_primary_bifs()
 	ThreadStats = id::find_type<RecordType>("ThreadStats");
 	BrokerStats = id::find_type<RecordType>("BrokerStats");
 	ReporterStats = id::find_type<RecordType>("ReporterStats");
+	IOSourceStats = id::find_type<RecordType>("IOSourceStats");
 
 	var_sizes = id::find_type("var_sizes")->AsTableType();
 
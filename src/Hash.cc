@@ -14,6 +14,8 @@
 
 #include "const.bif.netvar_h"
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek::detail {
 
 alignas(32) uint64_t KeyedHash::shared_highwayhash_key[4];
@@ -50,8 +52,109 @@ void KeyedHash::InitOptions()
 	calculate_digest(Hash_SHA256, BifConst::digest_salt->Bytes(), BifConst::digest_salt->Len(), reinterpret_cast<unsigned char*>(cluster_highwayhash_key));
 	}
 
+// SipHash, as in https://www.aumasson.jp/siphash/siphash.pdf, with C
+// rounds per word and D finalization rounds. highwayhash provides only
+// the 2-4 variant.
+namespace {
+
+struct SipState {
+	uint64_t v0, v1, v2, v3;
+};
+
+inline uint64_t rotl(uint64_t x, int b)
+	{
+	return (x << b) | (x >> (64 - b));
+	}
+
+inline uint64_t load64(const u_char* p)
+	{
+	uint64_t w;
+	memcpy(&w, p, sizeof(w));
+#ifdef WORDS_BIGENDIAN
+	w = __builtin_bswap64(w);
+#endif
+	return w;
+	}
+
+inline void sip_round(SipState& s)
+	{
+	s.v0 += s.v1; s.v1 = rotl(s.v1, 13); s.v1 ^= s.v0; s.v0 = rotl(s.v0, 32);
+	s.v2 += s.v3; s.v3 = rotl(s.v3, 16); s.v3 ^= s.v2;
+	s.v0 += s.v3; s.v3 = rotl(s.v3, 21); s.v3 ^= s.v0;
+	s.v2 += s.v1; s.v1 = rotl(s.v1, 17); s.v1 ^= s.v2; s.v2 = rotl(s.v2, 32);
+	}
+
+inline void sip_init(SipState& s, const unsigned long long key[2])
+	{
+	s.v0 = key[0] ^ 0x736f6d6570736575ULL;
+	s.v1 = key[1] ^ 0x646f72616e646f6dULL;
+	s.v2 = key[0] ^ 0x6c7967656e657261ULL;
+	s.v3 = key[1] ^ 0x7465646279746573ULL;
+	}
+
+template <int C>
+inline void sip_compress(SipState& s, uint64_t m)
+	{
+	s.v3 ^= m;
+
+	for ( int i = 0; i < C; ++i )
+		sip_round(s);
+
+	s.v0 ^= m;
+	}
+
+// Hashes the bytes from offset onwards, which must be a multiple of 8,
+// and finalizes.
+template <int C, int D>
+uint64_t sip_finish(SipState& s, const u_char* p, uint64_t offset, uint64_t size)
+	{
+	for ( ; offset + 8 <= size; offset += 8 )
+		sip_compress<C>(s, load64(p + offset));
+
+	// The last word holds the remaining bytes and, in its top byte, the
+	// size.
+	uint64_t b = size << 56;
+
+	for ( uint64_t i = 0; offset + i < size; ++i )
+		b |= static_cast<uint64_t>(p[offset + i]) << (8 * i);
+
+	sip_compress<C>(s, b);
+
+	s.v2 ^= 0xff;
+
+	for ( int i = 0; i < D; ++i )
+		sip_round(s);
+
+	return s.v0 ^ s.v1 ^ s.v2 ^ s.v3;
+	}
+
+template <int C, int D>
+uint64_t siphash(const unsigned long long key[2], const void* bytes, uint64_t size)
+	{
+	SipState s;
+	sip_init(s, key);
+	return sip_finish<C, D>(s, static_cast<const u_char*>(bytes), 0, size);
+	}
+
+} // namespace
+
+bool KeyedHash::SetHash64Function(const char* name)
+	{
+	if ( strcmp(name, "siphash24") == 0 )
+		use_siphash13 = false;
+	else if ( strcmp(name, "siphash13") == 0 )
+		use_siphash13 = true;
+	else
+		return false;
+
+	return true;
+	}
+
 hash64_t KeyedHash::Hash64(const void* bytes, uint64_t size)
 	{
+	if ( use_siphash13 )
+		return siphash<1, 3>(shared_siphash_key, bytes, size);
+
 	return highwayhash::SipHash(shared_siphash_key, reinterpret_cast<const char *>(bytes), size);
 	}
 
@@ -82,6 +185,54 @@ void KeyedHash::StaticHash256(const void* bytes, uint64_t size, hash256_t* resul
 	highwayhash::InstructionSets::Run<highwayhash::HighwayHash>(cluster_highwayhash_key, reinterpret_cast<const char *>(bytes), size, result);
 	}
 
+TEST_CASE("keyed hash siphash vectors")
+	{
+	// Reference values for key 00 01 .. 0f and messages 00 01 .. n-1;
+	// the SipHash-2-4 ones are from the paper's test vectors.
+	unsigned long long key[2] = {0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL};
+	u_char msg[64];
+
+	for ( size_t i = 0; i < sizeof(msg); ++i )
+		msg[i] = static_cast<u_char>(i);
+
+	struct Vector {
+		uint64_t size;
+		uint64_t sip24;
+		uint64_t sip13;
+	};
+
+	const Vector vectors[] = {
+		{0, 0x726fdb47dd0e0e31ULL, 0xabac0158050fc4dcULL},
+		{1, 0x74f839c593dc67fdULL, 0xc9f49bf37d57ca93ULL},
+		{7, 0xab0200f58b01d137ULL, 0xd3927d989bb11140ULL},
+		{8, 0x93f5f5799a932462ULL, 0x369095118d299a8eULL},
+		{15, 0xa129ca6149be45e5ULL, 0xd320d86d2a519956ULL},
+		{63, 0x958a324ceb064572ULL, 0x9d199062b7bbb3a8ULL},
+	};
+
+	for ( const auto& v : vectors )
+		{
+		CHECK((siphash<2, 4>(key, msg, v.size)) == v.sip24);
+		CHECK(highwayhash::SipHash(key, reinterpret_cast<const char*>(msg), v.size) == v.sip24);
+		CHECK((siphash<1, 3>(key, msg, v.size)) == v.sip13);
+		}
+	}
+
+TEST_CASE("keyed hash function selection")
+	{
+	const char* msg = "selecting the keyed hash function";
+	auto len = strlen(msg);
+
+	REQUIRE(KeyedHash::SetHash64Function("siphash13"));
+	auto h13 = KeyedHash::Hash64(msg, len);
+
+	REQUIRE(KeyedHash::SetHash64Function("siphash24"));
+	auto h24 = KeyedHash::Hash64(msg, len);
+
+	CHECK(h13 != h24);
+	CHECK(! KeyedHash::SetHash64Function("md5"));
+	}
+
 void init_hash_function()
 	{
 	// Make sure we have already called init_random_seed().
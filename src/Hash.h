@@ -20,6 +20,7 @@
 #pragma once
 
 #include <stdlib.h>
+#include <string_view>
 
 #include "zeek/util.h" // for bro_int_t
 
@@ -190,6 +191,21 @@ public:
 	 */
 	static void InitOptions();
 
+	/**
+	 * Selects the function behind Hash64(), by name.
+	 * "siphash24" is the default. "siphash13" does fewer rounds per
+	 * word and so is about 1.5 times as fast, while still being keyed. Both
+	 * use the same seed.
+	 *
+	 * This has to happen before the first hash gets computed, since
+	 * hashes computed before won't match the ones computed after.
+	 *
+	 * @param name The name of the function
+	 *
+	 * @return False if the name is unknown, else true
+	 */
+	static bool SetHash64Function(const char* name);
+
 private:
 	// actually HHKey. This key changes each start (unless a seed is specified)
 	alignas(32) static uint64_t shared_highwayhash_key[4];
@@ -200,11 +216,23 @@ private:
 	// This key changes each start (unless a seed is specified)
 	inline static uint8_t shared_hmac_md5_key[16];
 	inline static bool seeds_initialized = false;
+	// Selects SipHash-1-3 over SipHash-2-4 for Hash64().
+	inline static bool use_siphash13 = false;
 
 	friend void util::detail::hmac_md5(size_t size, const unsigned char* bytes, unsigned char digest[16]);
 	friend BifReturnVal BifFunc::md5_hmac_bif(zeek::detail::Frame* frame, const Args*);
 };
 
+/**
+ * A hash function object for standard containers keyed by strings that
+ * may come off the network. It uses KeyedHash::Hash64(), so others can't
+ * pick strings that collide.
+ */
+struct KeyedStringHash {
+	size_t operator()(std::string_view s) const
+		{ return KeyedHash::Hash64(s.data(), s.size()); }
+};
+
 typedef enum {
 	HASH_KEY_INT,
 	HASH_KEY_DOUBLE,
@@ -129,6 +129,7 @@ double tcp_partial_close_delay;
 int tcp_max_initial_window;
 int tcp_max_above_hole_without_any_acks;
 int tcp_excessive_data_without_further_acks;
+uint64_t tcp_reassembly_memory_budget;
 int tcp_max_old_segments;
 
 double non_analyzed_lifetime;
@@ -168,6 +169,7 @@ int other_addr_anonymization;
 
 double profiling_interval;
 int expensive_profiling_multiple;
+double core_metrics_interval;
 int segment_profiling;
 int pkt_profile_mode;
 double pkt_profile_freq;
@@ -177,6 +179,9 @@ int load_sample_freq;
 int packet_filter_default;
 
 int sig_max_group_size;
+int sig_literal_prefilter;
+uint64_t dfa_state_cache_budget;
+int sig_matcher_threads;
 
 int dpd_reassemble_first_packets;
 int dpd_buffer_size;
@@ -192,6 +197,11 @@ int record_all_packets;
 
 bro_uint_t bits_per_uid;
 
+uint64_t string_intern_max_entries;
+uint64_t string_intern_max_length;
+
+uint64_t prefix_table_snapshot_max_bytes;
+
 } // namespace zeek::detail. The namespace has be closed here before we include the netvar_def files.
 
 // Because of how the BIF include files are built with namespaces already in them,
@@ -237,9 +247,15 @@ void init_general_global_var()
 	table_incremental_step = id::find_val("table_incremental_step")->AsCount();
 	packet_filter_default = id::find_val("packet_filter_default")->AsBool();
 	sig_max_group_size = id::find_val("sig_max_group_size")->AsCount();
+	sig_literal_prefilter = id::find_val("sig_literal_prefilter")->AsBool();
+	dfa_state_cache_budget = id::find_val("dfa_state_cache_budget")->AsCount();
+	sig_matcher_threads = id::find_val("sig_matcher_threads")->AsCount();
 	check_for_unused_event_handlers = id::find_val("check_for_unused_event_handlers")->AsBool();
 	record_all_packets = id::find_val("record_all_packets")->AsBool();
 	bits_per_uid = id::find_val("bits_per_uid")->AsCount();
+	string_intern_max_entries = id::find_val("string_intern_max_entries")->AsCount();
+	string_intern_max_length = id::find_val("string_intern_max_length")->AsCount();
+	prefix_table_snapshot_max_bytes = id::find_val("prefix_table_snapshot_max_bytes")->AsCount();
 	}
 
 void init_builtin_types()
@@ -270,6 +286,7 @@ void init_net_var()
 	tcp_max_initial_window = id::find_val("tcp_max_initial_window")->AsCount();
 	tcp_max_above_hole_without_any_acks = id::find_val("tcp_max_above_hole_without_any_acks")->AsCount();
 	tcp_excessive_data_without_further_acks = id::find_val("tcp_excessive_data_without_further_acks")->AsCount();
+	tcp_reassembly_memory_budget = id::find_val("tcp_reassembly_memory_budget")->AsCount();
 	tcp_max_old_segments = id::find_val("tcp_max_old_segments")->AsCount();
 
 	non_analyzed_lifetime = id::find_val("non_analyzed_lifetime")->AsInterval();
@@ -329,6 +346,7 @@ void init_net_var()
 
 	expensive_profiling_multiple = id::find_val("expensive_profiling_multiple")->AsCount();
 	profiling_interval = id::find_val("profiling_interval")->AsInterval();
+	core_metrics_interval = id::find_val("core_metrics_interval")->AsInterval();
 	segment_profiling = id::find_val("segment_profiling")->AsBool();
 
 	pkt_profile_mode = id::find_val("pkt_profile_mode")->InternalInt();
@@ -30,6 +30,7 @@ extern double tcp_reset_delay;
 extern int tcp_max_initial_window;
 extern int tcp_max_above_hole_without_any_acks;
 extern int tcp_excessive_data_without_further_acks;
+extern uint64_t tcp_reassembly_memory_budget;
 extern int tcp_max_old_segments;
 
 extern double non_analyzed_lifetime;
@@ -70,6 +71,7 @@ extern double connection_status_update_interval;
 
 extern double profiling_interval;
 extern int expensive_profiling_multiple;
+extern double core_metrics_interval;
 
 extern int segment_profiling;
 extern int pkt_profile_mode;
@@ -79,6 +81,9 @@ extern int load_sample_freq;
 extern int packet_filter_default;
 
 extern int sig_max_group_size;
+extern int sig_literal_prefilter;
+extern uint64_t dfa_state_cache_budget;
+extern int sig_matcher_threads;
 
 extern int dpd_reassemble_first_packets;
 extern int dpd_buffer_size;
@@ -94,6 +99,11 @@ extern int record_all_packets;
 
 extern bro_uint_t bits_per_uid;
 
+extern uint64_t string_intern_max_entries;
+extern uint64_t string_intern_max_length;
+
+extern uint64_t prefix_table_snapshot_max_bytes;
+
 // Initializes globals that don't pertain to network/event analysis.
 extern void init_general_global_var();
 
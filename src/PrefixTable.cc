@@ -1,7 +1,15 @@
 #include "zeek/PrefixTable.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+#include "zeek/NetVar.h"
 #include "zeek/Reporter.h"
 #include "zeek/Val.h"
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek::detail {
 
 prefix_t* PrefixTable::MakePrefix(const IPAddr& addr, int width)
@@ -39,6 +47,7 @@ void* PrefixTable::Insert(const IPAddr& addr, int width, void* data)
 	// If there is no data to be associated with addr, we take the
 	// node itself.
 	node->data = data ? data : node;
+	Invalidate();
 
 	return old;
 	}
@@ -69,6 +78,31 @@ void* PrefixTable::Insert(const Val* value, void* data)
 std::list<std::tuple<IPPrefix,void*>> PrefixTable::FindAll(const IPAddr& addr, int width) const
 	{
 	std::list<std::tuple<IPPrefix,void*>> out;
+
+	ForEachMatch(addr, width, [&out](const IPPrefix& prefix, void* data)
+		{
+		out.emplace_back(prefix, data);
+		});
+
+	return out;
+	}
+
+void PrefixTable::ForEachMatch(const IPAddr& addr, int width, const MatchCallback& f) const
+	{
+	// The snapshot only handles single addresses. For wider searches,
+	// the tree may also return a longer prefix that matches the search's
+	// address, which we keep that way.
+	if ( const Snapshot* s = width == 128 ? GetSnapshot() : nullptr )
+		{
+		uint8_t bytes[16];
+		addr.CopyIPv6(reinterpret_cast<uint32_t*>(bytes));
+
+		for ( int i = s->Find(bytes); i >= 0; i = s->matches[i].parent )
+			f(s->matches[i].prefix, s->matches[i].data);
+
+		return;
+		}
+
 	prefix_t* prefix = MakePrefix(addr, width);
 
 	int elems = 0;
@@ -77,11 +111,10 @@ std::list<std::tuple<IPPrefix,void*>> PrefixTable::FindAll(const IPAddr& addr, i
 	patricia_search_all(tree, prefix, &list, &elems);
 
 	for ( int i = 0; i < elems; ++i )
-		out.push_back(std::make_tuple(PrefixToIPPrefix(list[i]->prefix), list[i]->data));
+		f(PrefixToIPPrefix(list[i]->prefix), list[i]->data);
 
 	Deref_Prefix(prefix);
 	free(list);
-	return out;
 	}
 
 std::list<std::tuple<IPPrefix,void*>> PrefixTable::FindAll(const SubNetVal* value) const
@@ -91,14 +124,20 @@ std::list<std::tuple<IPPrefix,void*>> PrefixTable::FindAll(const SubNetVal* valu
 
 void* PrefixTable::Lookup(const IPAddr& addr, int width, bool exact) const
 	{
+	if ( const Snapshot* s = ! exact && width == 128 ? GetSnapshot() : nullptr )
+		{
+		uint8_t bytes[16];
+		addr.CopyIPv6(reinterpret_cast<uint32_t*>(bytes));
+
+		int i = s->Find(bytes);
+		return i >= 0 ? s->matches[i].data : nullptr;
+		}
+
 	prefix_t* prefix = MakePrefix(addr, width);
 	patricia_node_t* node =
 		exact ? patricia_search_exact(tree, prefix) :
 			patricia_search_best(tree, prefix);
 
-	int elems = 0;
-	patricia_node_t** list = nullptr;
-
 	Deref_Prefix(prefix);
 	return node ? node->data : nullptr;
 	}
@@ -138,6 +177,7 @@ void* PrefixTable::Remove(const IPAddr& addr, int width)
 
 	void* old = node->data;
 	patricia_remove(tree, node);
+	Invalidate();
 
 	return old;
 	}
@@ -165,6 +205,328 @@ void* PrefixTable::Remove(const Val* value)
 	}
 	}
 
+const PrefixTable::Snapshot* PrefixTable::GetSnapshot() const
+	{
+	if ( snapshot )
+		return snapshot.get();
+
+	if ( snapshot_too_large || prefix_table_snapshot_max_bytes == 0 )
+		return nullptr;
+
+	// Building costs about as much as a lookup per prefix, so wait
+	// until the table looks stable enough to earn that back.
+	if ( ++lookups_since_change <= 16 + static_cast<uint64_t>(tree->num_active_node) )
+		return nullptr;
+
+	BuildSnapshot();
+	return snapshot.get();
+	}
+
+void PrefixTable::BuildSnapshot() const
+	{
+	auto s = std::make_unique<Snapshot>();
+	s->max_bytes = prefix_table_snapshot_max_bytes;
+	std::unordered_map<const patricia_node_t*, int> index;
+	std::vector<patricia_node_t*> stack;
+
+	if ( tree->head )
+		stack.push_back(tree->head);
+
+	while ( ! stack.empty() )
+		{
+		patricia_node_t* node = stack.back();
+		stack.pop_back();
+
+		if ( node->r )
+			stack.push_back(node->r);
+
+		if ( node->l )
+			stack.push_back(node->l);
+
+		if ( ! node->prefix )
+			continue;
+
+		index[node] = s->matches.size();
+		s->matches.push_back({PrefixToIPPrefix(node->prefix), node->data, -1});
+
+		// Keep only the bytes covered by the prefix.
+		uint8_t bytes[16];
+		memcpy(bytes, &node->prefix->add.sin6, sizeof(bytes));
+		int len = node->prefix->bitlen;
+
+		for ( int i = 0; i < 16; ++i )
+			{
+			int bits = std::clamp(len - i * 8, 0, 8);
+			bytes[i] &= static_cast<uint8_t>(0xff00 >> bits);
+			}
+
+		s->match_bytes.insert(s->match_bytes.end(), bytes, bytes + sizeof(bytes));
+		}
+
+	std::vector<int> members;
+
+	for ( const auto& [node, i] : index )
+		{
+		if ( node->prefix->bitlen == 0 )
+			{
+			s->default_match = i;
+			continue;
+			}
+
+		members.push_back(i);
+
+		auto parent = patricia_search_best2(tree, node->prefix, 0);
+
+		if ( parent )
+			s->matches[i].parent = index.at(parent);
+		}
+
+	if ( s->MemoryAllocation() > s->max_bytes ||
+	     (! members.empty() && s->Build(members, 0, s->default_match) < 0) )
+		{
+		// Stay with the tree until the table changes.
+		snapshot_too_large = true;
+		return;
+		}
+
+	s->nodes.shrink_to_fit();
+	s->entries.shrink_to_fit();
+	s->run_entries.shrink_to_fit();
+	s->run_firsts.shrink_to_fit();
+
+	snapshot = std::move(s);
+	}
+
+size_t PrefixTable::Snapshot::MemoryAllocation() const
+	{
+	return sizeof(*this) + matches.size() * sizeof(Match) + match_bytes.size() +
+		nodes.size() * sizeof(Node) +
+		(entries.size() + run_entries.size()) * sizeof(Entry) + run_firsts.size();
+	}
+
+int PrefixTable::Snapshot::Build(const std::vector<int>& members, int depth, int inherited)
+	{
+	auto len = [this](int m) { return matches[m].prefix.LengthIPv6(); };
+	auto byte = [this](int m, int i) { return match_bytes[m * 16 + i]; };
+
+	// Skip bytes on which all prefixes below agree and which none of
+	// them ends in.
+	int skip_from = depth;
+
+	for ( ; depth < 15; ++depth )
+		{
+		bool same = std::all_of(members.begin(), members.end(), [&](int m)
+			{
+			return len(m) > (depth + 1) * 8 && byte(m, depth) == byte(members[0], depth);
+			});
+
+		if ( ! same )
+			break;
+		}
+
+	if ( MemoryAllocation() + sizeof(Node) > max_bytes )
+		return -1;
+
+	int n = nodes.size();
+	nodes.emplace_back();
+	nodes[n].skip_from = skip_from;
+	nodes[n].depth = depth;
+	memcpy(nodes[n].key, &match_bytes[members[0] * 16], sizeof(nodes[n].key));
+
+	Entry node_entries[256];
+
+	for ( auto& e : node_entries )
+		e = {-1, inherited};
+
+	// Expand the prefixes ending in this byte to all the entries they
+	// cover, with longer ones overwriting shorter ones.
+	std::vector<int> ending;
+	std::vector<int> deeper[256];
+
+	for ( int m : members )
+		{
+		if ( len(m) > (depth + 1) * 8 )
+			deeper[byte(m, depth)].push_back(m);
+		else
+			ending.push_back(m);
+		}
+
+	std::sort(ending.begin(), ending.end(), [&](int a, int b) { return len(a) < len(b); });
+
+	for ( int m : ending )
+		{
+		int bits = len(m) - depth * 8;
+		int first = byte(m, depth);
+		int count = 1 << (8 - bits);
+
+		for ( int i = first; i < first + count; ++i )
+			node_entries[i].match = m;
+		}
+
+	// Building children grows the node vector, so we refer to this
+	// node by index.
+	for ( int i = 0; i < 256; ++i )
+		{
+		if ( deeper[i].empty() )
+			continue;
+
+		int child = Build(deeper[i], depth + 1, node_entries[i].match);
+
+		if ( child < 0 )
+			return -1;
+
+		node_entries[i].child = child;
+		}
+
+	auto run_starts = [&](int i)
+		{
+		return i == 0 || node_entries[i].child != node_entries[i - 1].child ||
+			node_entries[i].match != node_entries[i - 1].match;
+		};
+
+	int runs = 0;
+
+	for ( int i = 0; i < 256; ++i )
+		runs += run_starts(i);
+
+	if ( runs <= RUN_SLOTS )
+		{
+		nodes[n].num_runs = runs;
+		nodes[n].first = run_entries.size();
+
+		for ( int i = 0; i < 256; ++i )
+			if ( run_starts(i) )
+				{
+				run_firsts.push_back(i);
+				run_entries.push_back(node_entries[i]);
+				}
+
+		for ( int i = runs; i < RUN_SLOTS; ++i )
+			{
+			run_firsts.push_back(255);
+			run_entries.push_back(run_entries.back());
+			}
+		}
+	else
+		{
+		nodes[n].num_runs = 0;
+		nodes[n].first = entries.size();
+		entries.insert(entries.end(), node_entries, node_entries + 256);
+		}
+
+	if ( MemoryAllocation() > max_bytes )
+		return -1;
+
+	return n;
+	}
+
+int PrefixTable::Snapshot::Find(const uint8_t* addr) const
+	{
+	int best = default_match;
+
+	if ( nodes.empty() )
+		return best;
+
+	const Node* n = &nodes[0];
+
+	while ( true )
+		{
+		if ( n->skip_from != n->depth &&
+		     memcmp(addr + n->skip_from, n->key + n->skip_from, n->depth - n->skip_from) != 0 )
+			return best;
+
+		uint8_t b = addr[n->depth];
+		const Entry* e;
+
+		if ( n->num_runs )
+			{
+			// The first run starts at zero, so the byte falls into the
+			// one before the first run starting past it.
+			const uint8_t* firsts = &run_firsts[n->first];
+			int run = 0;
+
+			for ( int i = 1; i < RUN_SLOTS; ++i )
+				run += firsts[i] <= b;
+
+			e = &run_entries[n->first + run];
+			}
+		else
+			e = &entries[n->first + b];
+
+		best = e->match;
+
+		if ( e->child < 0 )
+			return best;
+
+		n = &nodes[e->child];
+		}
+	}
+
+TEST_CASE("prefix table snapshot")
+	{
+	auto saved_max_bytes = prefix_table_snapshot_max_bytes;
+	prefix_table_snapshot_max_bytes = 1 << 20;
+
+	PrefixTable t;
+	IPPrefix prefixes[] = {
+		IPPrefix(IPAddr("10.0.0.0"), 8), IPPrefix(IPAddr("10.1.0.0"), 16),
+		IPPrefix(IPAddr("10.1.2.0"), 23), IPPrefix(IPAddr("10.1.2.3"), 32),
+		IPPrefix(IPAddr("2001:db8::"), 32), IPPrefix(IPAddr("2001:db8::1"), 128),
+	};
+
+	for ( size_t i = 0; i < std::size(prefixes); ++i )
+		t.Insert(prefixes[i].Prefix(), prefixes[i].LengthIPv6(), &prefixes[i]);
+
+	IPAddr addrs[] = {IPAddr("10.1.2.3"), IPAddr("10.1.3.1"), IPAddr("10.200.0.1"),
+	                  IPAddr("11.0.0.1"), IPAddr("2001:db8::1"), IPAddr("2001:db8::2"),
+	                  IPAddr("2001:db9::1")};
+	void* expected[] = {&prefixes[3], &prefixes[2], &prefixes[0], nullptr,
+	                    &prefixes[5], &prefixes[4], nullptr};
+
+	// The first lookups go to the tree, later ones to the snapshot.
+	for ( int round = 0; round < 10; ++round )
+		for ( size_t i = 0; i < std::size(addrs); ++i )
+			CHECK(t.Lookup(addrs[i], 128, false) == expected[i]);
+
+	auto all = t.FindAll(IPAddr("10.1.2.3"), 128);
+	REQUIRE(all.size() == 4);
+	CHECK(std::get<0>(all.front()) == prefixes[3]);
+	CHECK(std::get<0>(all.back()) == prefixes[0]);
+
+	t.Remove(prefixes[3].Prefix(), prefixes[3].LengthIPv6());
+	CHECK(t.Lookup(addrs[0], 128, false) == &prefixes[2]);
+
+	// A node with more than RUN_SLOTS runs keeps all its entries.
+	PrefixTable dense;
+	std::vector<IPPrefix> slash16s;
+
+	for ( int i = 0; i < 200; ++i )
+		slash16s.emplace_back(IPAddr(util::fmt("172.%d.0.0", i)), 16);
+
+	for ( auto& p : slash16s )
+		dense.Insert(p.Prefix(), p.LengthIPv6(), &p);
+
+	for ( int round = 0; round < 300; ++round )
+		{
+		int i = round % 256;
+		void* want = i < 200 ? &slash16s[i] : nullptr;
+		CHECK(dense.Lookup(IPAddr(util::fmt("172.%d.1.2", i)), 128, false) == want);
+		}
+
+	// Too small a limit leaves lookups with the tree.
+	prefix_table_snapshot_max_bytes = 512;
+	PrefixTable small;
+
+	for ( size_t i = 0; i < std::size(prefixes); ++i )
+		small.Insert(prefixes[i].Prefix(), prefixes[i].LengthIPv6(), &prefixes[i]);
+
+	for ( int round = 0; round < 10; ++round )
+		for ( size_t i = 0; i < std::size(addrs); ++i )
+			CHECK(small.Lookup(addrs[i], 128, false) == expected[i]);
+
+	prefix_table_snapshot_max_bytes = saved_max_bytes;
+	}
+
 PrefixTable::iterator PrefixTable::InitIterator()
 	{
 	iterator i;
@@ -4,8 +4,11 @@ extern "C" {
 	#include "zeek/patricia.h"
 }
 
-#include <tuple>
+#include <functional>
 #include <list>
+#include <memory>
+#include <tuple>
+#include <vector>
 
 #include "zeek/IPAddr.h"
 
@@ -47,11 +50,17 @@ public:
 	std::list<std::tuple<IPPrefix, void*>> FindAll(const IPAddr& addr, int width) const;
 	std::list<std::tuple<IPPrefix, void*>> FindAll(const SubNetVal* value) const;
 
+	// Calls f for each prefix that contains addr/width, from the longest
+	// to the shortest. Unlike FindAll(), doesn't allocate once the table
+	// has a snapshot.
+	using MatchCallback = std::function<void(const IPPrefix& prefix, void* data)>;
+	void ForEachMatch(const IPAddr& addr, int width, const MatchCallback& f) const;
+
 	// Returns pointer to data or nil if not found.
 	void* Remove(const IPAddr& addr, int width);
 	void* Remove(const Val* value);
 
-	void Clear()	{ Clear_Patricia(tree, delete_function); }
+	void Clear()	{ Clear_Patricia(tree, delete_function); Invalidate(); }
 
 	// Sets a function to call for each node when table is cleared/destroyed.
 	void SetDeleteFunction(data_fn_t del_fn)	{ delete_function = del_fn; }
@@ -60,11 +69,80 @@ public:
 	void* GetNext(iterator* i);
 
 private:
+	// Longest-prefix matching of single addresses goes through an
+	// immutable multibit trie built from the patricia tree, which walks
+	// a byte of the address per step rather than a bit. Nodes at which
+	// all prefixes below agree on the next bytes skip those bytes, so
+	// IPv4 addresses don't walk through the 12 bytes of the IPv4-mapped
+	// IPv6 prefix. Changes to the table discard the snapshot. A new one
+	// gets built only once the table has served about as many lookups as
+	// it has prefixes without changing; until then, lookups go to the
+	// patricia tree. So do lookups in tables whose snapshot would exceed
+	// prefix_table_snapshot_max_bytes.
+	struct Snapshot {
+		struct Match {
+			IPPrefix prefix;
+			void* data;
+			int parent; // Longest match containing this one, or -1.
+		};
+
+		struct Entry {
+			int32_t child; // Index of the node for the next byte, or -1.
+			int32_t match; // Longest match covering this entry, or -1.
+		};
+
+		// Most nodes have only a few distinct entries: one per child
+		// and per range of bytes covered by a prefix. Nodes with up to
+		// RUN_SLOTS runs of equal entries keep them in run_entries, with
+		// run_firsts holding the byte each run starts at. Unused slots
+		// start at 255 and repeat the last run, so lookups can always
+		// compare all of them. Other nodes keep all 256 entries in
+		// entries.
+		static constexpr int RUN_SLOTS = 8;
+
+		struct Node {
+			uint8_t skip_from;	// Bytes [skip_from, depth) must equal key's.
+			uint8_t depth;		// The byte of the address that indexes entries.
+			uint16_t num_runs;	// Zero for nodes with all 256 entries.
+			int32_t first;		// Index of the node's first entry or run.
+			uint8_t key[16];
+		};
+
+		// Returns the index of the longest match containing addr, or -1.
+		int Find(const uint8_t* addr) const;
+
+		// Returns the node's index, or -1 once the snapshot grows past
+		// max_bytes.
+		int Build(const std::vector<int>& members, int depth, int inherited);
+
+		size_t MemoryAllocation() const;
+
+		std::vector<Match> matches;
+		std::vector<uint8_t> match_bytes; // The 16 address bytes of each match.
+		std::vector<Node> nodes;
+		std::vector<Entry> entries;
+		std::vector<Entry> run_entries;
+		std::vector<uint8_t> run_firsts;
+		int default_match = -1;
+		size_t max_bytes = 0;
+	};
+
 	static prefix_t* MakePrefix(const IPAddr& addr, int width);
 	static IPPrefix PrefixToIPPrefix(prefix_t* p);
 
+	// Returns the snapshot, building it if it's due, or null if lookups
+	// should use the tree.
+	const Snapshot* GetSnapshot() const;
+	void BuildSnapshot() const;
+	void Invalidate()
+		{ snapshot.reset(); snapshot_too_large = false; lookups_since_change = 0; }
+
 	patricia_tree_t* tree;
 	data_fn_t delete_function;
+
+	mutable std::unique_ptr<Snapshot> snapshot;
+	mutable uint64_t lookups_since_change = 0;
+	mutable bool snapshot_too_large = false;
 };
 
 } // namespace detail
@@ -310,9 +310,35 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as,
 		accepted_matches.insert(am_idx(*it, position));
 	}
 
+RE_Match_State::~RE_Match_State()
+	{
+	Unref(current_state);
+	}
+
+void RE_Match_State::Clear()
+	{
+	current_pos = -1;
+	Unref(current_state);
+	current_state = nullptr;
+	accepted_matches.clear();
+	}
+
+void RE_Match_State::HoldState(DFA_State* old_state)
+	{
+	if ( current_state == old_state )
+		return;
+
+	if ( current_state )
+		Ref(current_state);
+
+	Unref(old_state);
+	}
+
 bool RE_Match_State::Match(const u_char* bv, int n,
-				bool bol, bool eol, bool clear)
+				bool bol, bool eol, bool clear, int pos)
 	{
+	DFA_State* old_state = current_state;
+
 	if ( current_pos == -1 )
 		{
 		// First call to Match().
@@ -333,9 +359,12 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		current_state = dfa->StartState();
 
 	if ( ! current_state )
+		{
+		HoldState(old_state);
 		return false;
+		}
 
-	current_pos = 0;
+	current_pos = pos;
 
 	size_t old_matches = accepted_matches.size();
 
@@ -370,6 +399,8 @@ bool RE_Match_State::Match(const u_char* bv, int n,
 		current_state = next_state;
 		}
 
+	HoldState(old_state);
+
 	return accepted_matches.size() != old_matches;
 	}
 
@@ -154,6 +154,11 @@ public:
 		current_state = nullptr;
 		}
 
+	~RE_Match_State();
+
+	RE_Match_State(const RE_Match_State&) = delete;
+	RE_Match_State& operator=(const RE_Match_State&) = delete;
+
 	const AcceptingMatchSet& AcceptedMatches() const
 		{ return accepted_matches; }
 
@@ -161,23 +166,26 @@ public:
 	int Length()	{ return current_pos; }
 
 	// Returns true if this inputs leads to at least one new match.
-	// If clear is true, starts matching over.
-	bool Match(const u_char* bv, int n, bool bol, bool eol, bool clear);
+	// If clear is true, starts matching over. Positions of matches
+	// start counting at pos, for input that's skipped ahead.
+	bool Match(const u_char* bv, int n, bool bol, bool eol, bool clear,
+	           int pos = 0);
 
-	void Clear()
-		{
-		current_pos = -1;
-		current_state = nullptr;
-		accepted_matches.clear();
-		}
+	void Clear();
 
 	void AddMatches(const AcceptingSet& as, MatchPos position);
 
 protected:
+	// Takes a reference to the current state, releasing old_state.
+	void HoldState(DFA_State* old_state);
+
 	DFA_Machine* dfa;
 	int* ecs;
 
 	AcceptingMatchSet accepted_matches;
+
+	// We hold a reference to this one, as the DFA's state cache may
+	// evict it between calls to Match().
 	DFA_State* current_state;
 	int current_pos;
 };
@@ -289,6 +289,10 @@ public:
 	[[deprecated("Remove in v5.1. MemoryAllocation() is deprecated and will be removed. See GHI-572.")]]
 	static uint64_t MemoryAllocation(ReassemblerType rtype);
 
+	// Number of bytes currently buffered by all reassemblers of a type,
+	// including the per-block overhead.
+	static uint64_t BufferedBytes(ReassemblerType rtype)	{ return sizes[rtype]; }
+
 	void SetMaxOldBlocks(uint32_t count)	{ max_old_blocks = count; }
 
 protected:
@@ -2,8 +2,15 @@
 #include "zeek/zeek-config.h"
 #include "zeek/RuleMatcher.h"
 
+#include <pthread.h>
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
 #include <functional>
+#include <mutex>
+#include <thread>
 
 #include "zeek/RuleAction.h"
 #include "zeek/RuleCondition.h"
@@ -42,6 +49,131 @@ namespace zeek::detail {
 
 uint32_t RuleHdrTest::idcounter = 0;
 
+// Below this many bytes times matchers, handing the matchers to the
+// threads costs more than it saves.
+static constexpr int MIN_PARALLEL_WORK = 16 * 1024;
+
+// Runs batches of independent tasks on a set of threads, with the calling
+// thread taking part. The tasks of a batch must not touch any state that
+// another one of them touches as well. Note that matching may evict DFA
+// states, so their destructors run on these threads too, see
+// DFA_State_Cache::Evict().
+class RuleMatcherPool {
+public:
+	explicit RuleMatcherPool(int num_threads);
+	~RuleMatcherPool();
+
+	// Runs f(0) to f(n - 1) and returns once all of them have finished.
+	void Run(int n, const std::function<void(int)>& f);
+
+private:
+	void Work();
+	void Loop();
+
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable ready; // Signaled when a batch starts.
+	std::condition_variable done; // Signaled when a thread is done with it.
+	const std::function<void(int)>* task = nullptr;
+	int num_tasks = 0;
+	uint64_t batch = 0;
+	int busy = 0; // Threads working on the current batch.
+	bool stopping = false;
+
+	std::atomic<int> next_task{0};
+	std::atomic<int> finished_tasks{0};
+};
+
+RuleMatcherPool::RuleMatcherPool(int num_threads)
+	{
+	// Signals are handled by the main thread only, like for all our other
+	// threads. New threads inherit the creator's mask, so blocking them
+	// here leaves no window in which a thread could receive one. The
+	// signals that report a thread's own faults stay unblocked.
+	sigset_t mask_set, old_set;
+	sigfillset(&mask_set);
+	sigdelset(&mask_set, SIGFPE);
+	sigdelset(&mask_set, SIGILL);
+	sigdelset(&mask_set, SIGSEGV);
+	sigdelset(&mask_set, SIGBUS);
+	pthread_sigmask(SIG_BLOCK, &mask_set, &old_set);
+
+	for ( int i = 0; i < num_threads; ++i )
+		threads.emplace_back(&RuleMatcherPool::Loop, this);
+
+	pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+	}
+
+RuleMatcherPool::~RuleMatcherPool()
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		}
+
+	ready.notify_all();
+
+	for ( auto& t : threads )
+		t.join();
+	}
+
+void RuleMatcherPool::Run(int n, const std::function<void(int)>& f)
+	{
+		{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = &f;
+		num_tasks = n;
+		next_task = 0;
+		finished_tasks = 0;
+		++batch;
+		}
+
+	ready.notify_all();
+	Work();
+
+	// Threads still busy may be about to look for another task, so we
+	// can't start the next batch before they're done.
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return finished_tasks == num_tasks && busy == 0; });
+	task = nullptr;
+	}
+
+void RuleMatcherPool::Work()
+	{
+	int i;
+
+	while ( (i = next_task++) < num_tasks )
+		{
+		(*task)(i);
+		++finished_tasks;
+		}
+	}
+
+void RuleMatcherPool::Loop()
+	{
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while ( true )
+		{
+		ready.wait(lock, [&] { return stopping || (task && batch != seen); });
+
+		if ( stopping )
+			return;
+
+		seen = batch;
+		++busy;
+		lock.unlock();
+
+		Work();
+
+		lock.lock();
+		--busy;
+		done.notify_one();
+		}
+	}
+
 static bool is_member_of(const int_list& l, int_list::value_type v)
 	{
 	return std::find(l.begin(), l.end(), v) != l.end();
@@ -141,6 +273,7 @@ RuleHdrTest::~RuleHdrTest()
 		for ( auto pset : psets[i] )
 			{
 			delete pset->re;
+			delete pset->filter;
 			delete pset;
 			}
 		}
@@ -439,34 +572,266 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 	{
 	assert(static_cast<size_t>(exprs.length()) == ids.size());
 
-	// We build groups of at most sig_max_group_size regexps.
+	// Patterns starting with a literal go into groups of their own, so
+	// that those groups can use a literal filter.
+	string_list part_exprs[2];
+	int_list part_ids[2];
+
+	loop_over_list(exprs, i)
+		{
+		std::string literal;
+		bool nocase;
+		int part = sig_literal_prefilter &&
+			RuleLiteralFilter::ExtractLiteral(exprs[i], &literal, &nocase);
+
+		part_exprs[part].push_back(exprs[i]);
+		part_ids[part].push_back(ids[i]);
+		}
+
+	for ( int part = 0; part < 2; ++part )
+		{
+		if ( part_exprs[part].empty() )
+			continue;
+
+		// We build groups of at most sig_max_group_size regexps.
+
+		string_list group_exprs;
+		int_list group_ids;
+
+		for ( int i = 0; i < part_exprs[part].length() + 1 /* sic! */; i++ )
+			{
+			if ( i < part_exprs[part].length() )
+				{
+				group_exprs.push_back(part_exprs[part][i]);
+				group_ids.push_back(part_ids[part][i]);
+				}
+
+			if ( group_exprs.length() > sig_max_group_size ||
+			     i == part_exprs[part].length() )
+				{
+				RuleHdrTest::PatternSet* set =
+					new RuleHdrTest::PatternSet;
+				set->re = new Specific_RE_Matcher(MATCH_EXACTLY, 1);
+				set->re->CompileSet(group_exprs, group_ids);
+
+				if ( part )
+					set->filter = RuleLiteralFilter::Build(group_exprs);
+
+				set->patterns = group_exprs;
+				set->ids = group_ids;
+				dst->push_back(set);
+
+				group_exprs.clear();
+				group_ids.clear();
+				}
+			}
+		}
+	}
+
+// Maps upper-case ASCII letters to lower-case ones, and all other bytes
+// to themselves.
+static const u_char* fold_table()
+	{
+	static u_char table[256];
+	static bool initialized = false;
+
+	if ( ! initialized )
+		{
+		for ( int i = 0; i < 256; ++i )
+			table[i] = (i >= 'A' && i <= 'Z') ? i - 'A' + 'a' : i;
+
+		initialized = true;
+		}
+
+	return table;
+	}
+
+bool RuleLiteralFilter::ExtractLiteral(const char* pattern, std::string* literal,
+                                       bool* nocase)
+	{
+	const u_char* fold = fold_table();
+
+	*nocase = strncmp(pattern, "(?i:", 4) == 0;
+	literal->clear();
+
+	// Make sure there's no alternation at the top level, which would
+	// allow for matches without the literal, and that a leading
+	// "(?i:" covers the whole pattern.
+	int depth = 0;
+
+	for ( const char* p = pattern; *p; ++p )
+		{
+		switch ( *p ) {
+		case '\\':
+			if ( ! *++p )
+				return false;
+			break;
+
+		case '"':
+			while ( *++p && *p != '"' )
+				;
+
+			if ( ! *p )
+				return false;
+			break;
+
+		case '[':
+			// A ']' right after the opening bracket (and an
+			// optional '^') is part of the class.
+			if ( *++p == '^' )
+				++p;
+
+			if ( *p == ']' )
+				++p;
+
+			for ( ; *p && *p != ']'; ++p )
+				if ( *p == '\\' && ! *++p )
+					return false;
+
+			if ( ! *p )
+				return false;
+			break;
+
+		case '(':
+			++depth;
+			break;
+
+		case ')':
+			if ( --depth == 0 && *nocase && p[1] )
+				return false;
+			break;
+
+		case '|':
+			if ( depth == (*nocase ? 1 : 0) )
+				return false;
+			break;
+		}
+		}
+
+	const char* p = pattern + (*nocase ? 4 : 0);
+
+	if ( strncmp(p, ".*", 2) != 0 )
+		return false;
+
+	p += 2;
+
+	while ( *p && literal->size() < static_cast<size_t>(MAX_LITERAL) )
+		{
+		int c;
+		const char* next;
+
+		if ( *p == '\\' )
+			{
+			// Octal escapes may be longer than what
+			// expand_escape() consumes, so leave them alone.
+			if ( (p[1] >= '0' && p[1] <= '7') ||
+			     (p[1] == 'x' && ! (isxdigit(p[2]) && isxdigit(p[3]))) ||
+			     ! p[1] || p[1] == '\n' )
+				break;
+
+			next = p + 1;
+			c = util::detail::expand_escape(next);
+			}
+
+		else if ( strchr("^$\"[](){}|*+?.\n", *p) )
+			break;
+
+		else
+			{
+			c = *p;
+			next = p + 1;
+			}
+
+		// A quantifier makes the character optional or repeats it.
+		if ( *next && strchr("*?{+", *next) )
+			{
+			if ( *next == '+' )
+				literal->push_back(c);
+
+			break;
+			}
+
+		literal->push_back(c);
+		p = next;
+		}
+
+	if ( literal->size() < 2 )
+		return false;
+
+	if ( *nocase )
+		for ( auto& c : *literal )
+			c = fold[static_cast<u_char>(c)];
 
-	string_list group_exprs;
-	int_list group_ids;
+	return true;
+	}
 
-	for ( int i = 0; i < exprs.length() + 1 /* sic! */; i++ )
+RuleLiteralFilter* RuleLiteralFilter::Build(const string_list& patterns)
+	{
+	const u_char* fold = fold_table();
+	auto f = new RuleLiteralFilter();
+
+	for ( const auto& pattern : patterns )
 		{
-		if ( i < exprs.length() )
+		Literal l;
+
+		if ( ! ExtractLiteral(pattern, &l.text, &l.nocase) )
 			{
-			group_exprs.push_back(exprs[i]);
-			group_ids.push_back(ids[i]);
+			delete f;
+			return nullptr;
 			}
 
-		if ( group_exprs.length() > sig_max_group_size ||
-		     i == exprs.length() )
+		auto t = reinterpret_cast<const u_char*>(l.text.data());
+		uint16_t prefix = (fold[t[0]] << 8) | fold[t[1]];
+
+		f->prefixes[prefix >> 6] |= uint64_t(1) << (prefix & 63);
+		f->by_prefix.emplace_back(prefix, f->literals.size());
+		f->max_len = std::max(f->max_len, static_cast<int>(l.text.size()));
+		f->literals.push_back(std::move(l));
+		}
+
+	std::sort(f->by_prefix.begin(), f->by_prefix.end());
+	return f;
+	}
+
+int RuleLiteralFilter::Find(const u_char* data, int len) const
+	{
+	const u_char* fold = fold_table();
+
+	for ( int i = 0; i + 1 < len; ++i )
+		{
+		uint16_t prefix = (fold[data[i]] << 8) | fold[data[i + 1]];
+
+		if ( ! (prefixes[prefix >> 6] & (uint64_t(1) << (prefix & 63))) )
+			continue;
+
+		auto it = std::lower_bound(by_prefix.begin(), by_prefix.end(),
+		                           std::make_pair(prefix, 0));
+
+		for ( ; it != by_prefix.end() && it->first == prefix; ++it )
 			{
-			RuleHdrTest::PatternSet* set =
-				new RuleHdrTest::PatternSet;
-			set->re = new Specific_RE_Matcher(MATCH_EXACTLY, 1);
-			set->re->CompileSet(group_exprs, group_ids);
-			set->patterns = group_exprs;
-			set->ids = group_ids;
-			dst->push_back(set);
-
-			group_exprs.clear();
-			group_ids.clear();
+			const Literal& l = literals[it->second];
+			int n = l.text.size();
+
+			if ( i + n > len )
+				continue;
+
+			// The first two bytes only matched case-insensitively.
+			auto t = reinterpret_cast<const u_char*>(l.text.data());
+			int j = l.nocase ? 2 : 0;
+
+			if ( l.nocase )
+				while ( j < n && fold[data[i + j]] == t[j] )
+					++j;
+			else
+				while ( j < n && data[i + j] == t[j] )
+					++j;
+
+			if ( j == n )
+				return i;
 			}
 		}
+
+	return -1;
 	}
 
 // Get a 8/16/32-bit value from the given position in the packet header
@@ -782,6 +1147,10 @@ RuleEndpointState* RuleMatcher::InitEndpoint(analyzer::Analyzer* analyzer,
 					auto* m = new RuleEndpointState::Matcher;
 					m->state = new RE_Match_State(set->re);
 					m->type = (Rule::PatternType) i;
+					m->filter = set->filter;
+					m->filtering = set->filter != nullptr;
+					m->restart = false;
+					m->tail_len = 0;
 					state->matchers.push_back(m);
 					}
 				}
@@ -865,8 +1234,6 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type,
 	// for 'accepted' (that depends on the average number of matching
 	// patterns).
 
-	bool newmatch = false;
-
 #ifdef DEBUG
 	if ( debug_logger.IsEnabled(DBG_RULES) )
 		{
@@ -892,13 +1259,7 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type,
 		}
 
 	// Feed data into all relevant matchers.
-	for ( const auto& m : state->matchers )
-		{
-		if ( m->type == type &&
-		     m->state->Match((const u_char*) data, data_len,
-					bol, eol, clear) )
-			newmatch = true;
-		}
+	bool newmatch = MatchAllData(state, type, data, data_len, bol, eol, clear);
 
 	// If no new match found, we're already done.
 	if ( ! newmatch )
@@ -975,6 +1336,136 @@ void RuleMatcher::Match(RuleEndpointState* state, Rule::PatternType type,
 		}
 	}
 
+bool RuleMatcher::MatchAllData(RuleEndpointState* state, Rule::PatternType type,
+                               const u_char* data, int data_len, bool bol, bool eol,
+                               bool clear)
+	{
+	bool newmatch = false;
+
+	if ( sig_matcher_threads > 0 &&
+	     data_len * state->matchers.length() >= MIN_PARALLEL_WORK )
+		{
+		for ( const auto& m : state->matchers )
+			if ( m->type == type )
+				pool_matchers.push_back(m);
+
+		if ( pool_matchers.size() < 2 ||
+		     data_len * static_cast<int>(pool_matchers.size()) < MIN_PARALLEL_WORK )
+			pool_matchers.clear();
+		}
+
+	if ( pool_matchers.empty() )
+		{
+		for ( const auto& m : state->matchers )
+			{
+			if ( m->type == type &&
+			     MatchData(m, data, data_len, bol, eol, clear) )
+				newmatch = true;
+			}
+
+		return newmatch;
+		}
+
+	// Each matcher has its own DFA and match state, so they can go
+	// in parallel. As we wait for all of them, the rest of the
+	// matching continues in order.
+	if ( ! pool )
+		pool = std::make_unique<RuleMatcherPool>(sig_matcher_threads);
+
+	pool_results.assign(pool_matchers.size(), 0);
+
+	pool->Run(pool_matchers.size(), [&](int i)
+		{
+		pool_results[i] = MatchData(pool_matchers[i], data, data_len, bol, eol, clear);
+		});
+
+	for ( auto r : pool_results )
+		if ( r )
+			newmatch = true;
+
+	pool_matchers.clear();
+	return newmatch;
+	}
+
+bool RuleMatcher::MatchData(RuleEndpointState::Matcher* m, const u_char* data,
+                            int data_len, bool bol, bool eol, bool clear)
+	{
+	// Starting over means that filtering does too.
+	if ( clear && m->filter )
+		{
+		m->filtering = true;
+		m->restart = true;
+		m->tail_len = 0;
+		}
+
+	if ( ! m->filtering )
+		return m->state->Match(data, data_len, bol, eol, clear);
+
+	const RuleLiteralFilter* f = m->filter;
+	int keep = f->MaxLength() - 1;
+
+	// Position of the first literal, counting from the start of the
+	// tail.
+	int hit = -1;
+
+	if ( m->tail_len > 0 && data_len > 0 )
+		{
+		u_char buf[2 * RuleLiteralFilter::MAX_LITERAL];
+		int n = std::min(data_len, keep);
+
+		memcpy(buf, m->tail, m->tail_len);
+		memcpy(buf + m->tail_len, data, n);
+
+		int i = f->Find(buf, m->tail_len + n);
+
+		if ( i >= 0 && i < m->tail_len )
+			hit = i;
+		}
+
+	if ( hit < 0 )
+		{
+		int i = f->Find(data, data_len);
+
+		if ( i >= 0 )
+			hit = m->tail_len + i;
+		}
+
+	if ( hit >= 0 )
+		{
+		// Another literal may start a bit earlier but continue past
+		// the end of the data, so the state gets those bytes as well.
+		// From here on, it gets everything.
+		int start = std::max(0, hit - keep);
+		m->filtering = false;
+
+		if ( start < m->tail_len )
+			{
+			m->state->Match(m->tail + start, m->tail_len - start, false, false, m->restart);
+			return m->state->Match(data, data_len, false, eol, false);
+			}
+
+		start -= m->tail_len;
+		return m->state->Match(data + start, data_len - start, false, eol, m->restart, start);
+		}
+
+	// Keep the bytes that may start a literal ending in the next chunk.
+	if ( data_len >= keep )
+		{
+		memcpy(m->tail, data + data_len - keep, keep);
+		m->tail_len = keep;
+		}
+
+	else
+		{
+		int old = std::min(m->tail_len, keep - data_len);
+		memmove(m->tail, m->tail + m->tail_len - old, old);
+		memcpy(m->tail + old, data, data_len);
+		m->tail_len = old + data_len;
+		}
+
+	return false;
+	}
+
 void RuleMatcher::FinishEndpoint(RuleEndpointState* state)
 	{
 	// Send EOL to payload matchers.
@@ -1127,7 +1618,12 @@ void RuleMatcher::ClearEndpointState(RuleEndpointState* state)
 	state->payload_size = -1;
 
 	for ( const auto& matcher : state->matchers )
+		{
 		matcher->state->Clear();
+		matcher->filtering = matcher->filter != nullptr;
+		matcher->restart = false;
+		matcher->tail_len = 0;
+		}
 	}
 
 void RuleMatcher::ClearFileMagicState(RuleFileMagicState* state) const
@@ -1201,6 +1697,8 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 		stats->mem = 0;
 		stats->hits = 0;
 		stats->misses = 0;
+		stats->evictions = 0;
+		stats->evicted_mem = 0;
 		stats->nfa_states = 0;
 		hdr_test = root;
 		}
@@ -1221,6 +1719,8 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test)
 			stats->mem += cstats.mem;
 			stats->hits += cstats.hits;
 			stats->misses += cstats.misses;
+			stats->evictions += cstats.evictions;
+			stats->evicted_mem += cstats.evicted_mem;
 			stats->nfa_states += cstats.nfa_states;
 			}
 		}
@@ -1238,8 +1738,12 @@ void RuleMatcher::DumpStats(File* f)
 	                         "computed trans. = %d; matchers = %d; mem = %d\n",
 	                         run_state::network_time, stats.dfa_states, stats.computed,
 	                         stats.matchers, stats.mem));
-	f->Write(util::fmt("%.6f DFA cache hits = %d; misses = %d\n", run_state::network_time,
-	                         stats.hits, stats.misses));
+	f->Write(util::fmt("%.6f DFA cache hits = %d; misses = %d; hit rate = %.2f%%\n",
+	                         run_state::network_time, stats.hits, stats.misses,
+	                         stats.hits + stats.misses ?
+	                         100.0 * stats.hits / (stats.hits + stats.misses) : 0.0));
+	f->Write(util::fmt("%.6f DFA evictions = %" PRIu64 "; evicted mem = %" PRIu64 "\n", run_state::network_time,
+	                         stats.evictions, stats.evicted_mem));
 
 	DumpStateStats(f, root);
 	}
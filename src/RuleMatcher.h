@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <functional>
 #include <set>
 #include <string>
@@ -42,6 +43,7 @@ namespace detail {
 class RE_Match_State;
 class Specific_RE_Matcher;
 class RuleMatcher;
+class RuleMatcherPool;
 class IntSet;
 
 extern RuleMatcher* rule_matcher;
@@ -70,6 +72,53 @@ extern void id_to_maskedvallist(const char* id, maskedvalue_list* append_to,
 extern char* id_to_str(const char* id);
 extern uint32_t id_to_uint(const char* id);
 
+// Searches data for a set of literals, each of which is required by one
+// of the patterns of a group. If all patterns of a group start with ".*"
+// followed by a literal, nothing can match before the first of the
+// literals shows up, so the group's DFA doesn't need to see any of the
+// data preceding it.
+class RuleLiteralFilter {
+public:
+	// Longer literals get truncated to this length.
+	static constexpr int MAX_LITERAL = 16;
+
+	// Returns a filter for the given patterns, or nil if not all of
+	// them start with a literal.
+	static RuleLiteralFilter* Build(const string_list& patterns);
+
+	// Extracts the literal that the pattern starts with after a
+	// leading ".*". Returns false if there's none of at least two
+	// bytes.
+	static bool ExtractLiteral(const char* pattern, std::string* literal,
+	                           bool* nocase);
+
+	// Returns the offset of the first literal fully contained in data,
+	// or -1 if there's none.
+	int Find(const u_char* data, int len) const;
+
+	// Returns the length of the longest literal.
+	int MaxLength() const	{ return max_len; }
+
+private:
+	RuleLiteralFilter() = default;
+
+	struct Literal {
+		std::string text; // Lower-cased if nocase.
+		bool nocase;
+	};
+
+	std::vector<Literal> literals;
+
+	// Literal indices, sorted by the case-folded first two bytes of
+	// the literal.
+	std::vector<std::pair<uint16_t, int>> by_prefix;
+
+	// Bitmap of the case-folded first two bytes of all literals.
+	uint64_t prefixes[65536 / 64] = { 0 };
+
+	int max_len = 0;
+};
+
 class RuleHdrTest {
 public:
 	// Note: Adapt RuleHdrTest::PrintDebug() when changing these enums.
@@ -107,7 +156,7 @@ private:
 	friend class RuleMatcher;
 
 	struct PatternSet {
-		PatternSet() : re() {}
+		PatternSet() : re(), filter() {}
 
 		// If we're above the 'RE_level' (see RuleMatcher), this
 		// expr contains all patterns on this node. If we're on
@@ -115,6 +164,10 @@ private:
 		// of any of its children.
 		Specific_RE_Matcher* re;
 
+		// If non-nil, matching can skip data until one of the
+		// filter's literals shows up.
+		RuleLiteralFilter* filter;
+
 		// All the patterns and their rule indices.
 		string_list patterns;
 		int_list ids;	// (only needed for debugging)
@@ -167,6 +220,15 @@ private:
 	struct Matcher {
 		RE_Match_State* state;
 		Rule::PatternType type;
+
+		// While filtering, data doesn't go into the state until one
+		// of the filter's literals shows up. The tail holds the last
+		// bytes seen, for finding literals that span chunks.
+		const RuleLiteralFilter* filter;
+		bool filtering;
+		bool restart;	// whether the state needs to start over
+		int tail_len;
+		u_char tail[RuleLiteralFilter::MAX_LITERAL];
 	};
 
 	using matcher_list = PList<Matcher>;
@@ -305,6 +367,8 @@ public:
 		// # cache hits (sampled, multiply by MOVE_TO_FRONT_SAMPLE_SIZE)
 		unsigned int hits;
 		unsigned int misses;	// # cache misses
+		uint64_t evictions;	// # DFA states evicted
+		uint64_t evicted_mem;	// # bytes released by evictions
 	};
 
 	Val* BuildRuleStateValue(const Rule* rule,
@@ -331,6 +395,18 @@ private:
 	void BuildPatternSets(RuleHdrTest::pattern_set_list* dst,
 				const string_list& exprs, const int_list& ids);
 
+	// Feed data into one of an endpoint's matchers. Returns true if
+	// this leads to a new match.
+	bool MatchData(RuleEndpointState::Matcher* m, const u_char* data,
+	               int data_len, bool bol, bool eol, bool clear);
+
+	// Feeds data into all of an endpoint's matchers of the given type,
+	// spreading them across the matcher threads if it's worth it.
+	// Returns true if this leads to a new match.
+	bool MatchAllData(RuleEndpointState* state, Rule::PatternType type,
+	                  const u_char* data, int data_len, bool bol, bool eol,
+	                  bool clear);
+
 	// Check an arbitrary rule if it's satisfied right now.
 	// eos signals end of stream
 	void ExecRule(Rule* rule, RuleEndpointState* state, bool eos);
@@ -365,6 +441,11 @@ private:
 	RuleHdrTest* root;
 	rule_list rules;
 	rule_dict rules_by_id;
+
+	// Threads helping with MatchAllData(), created on first use.
+	std::unique_ptr<RuleMatcherPool> pool;
+	std::vector<RuleEndpointState::Matcher*> pool_matchers;
+	std::vector<char> pool_results;
 };
 
 // Keeps bi-directional matching-state.
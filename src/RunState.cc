@@ -29,6 +29,8 @@ extern "C" {
 #include "zeek/Timer.h"
 #include "zeek/ID.h"
 #include "zeek/Reporter.h"
+#include "zeek/SamplingProfiler.h"
+#include "zeek/ShuntTable.h"
 #include "zeek/Scope.h"
 #include "zeek/Anon.h"
 #include "zeek/iosource/Manager.h"
@@ -328,6 +330,7 @@ void run_loop()
 			}
 
 		event_mgr.Drain();
+		zeek::detail::sampling_profiler.ProcessToggleSignal();
 
 		processing_start_time = 0.0;	// = "we're not processing now"
 		current_dispatched = 0;
@@ -384,6 +387,9 @@ void finish_run(int drain_events)
 
 	if ( drain_events )
 		{
+		if ( zeek::detail::shunt_table )
+			zeek::detail::shunt_table->Done();
+
 		if ( session_mgr )
 			session_mgr->Drain();
 
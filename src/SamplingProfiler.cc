@@ -0,0 +1,200 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+#include "zeek/SamplingProfiler.h"
+
+#include <sys/time.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#include "zeek/Frame.h"
+#include "zeek/Func.h"
+#include "zeek/Reporter.h"
+#include "zeek/Stmt.h"
+#include "zeek/Val.h"
+#include "zeek/ID.h"
+#include "zeek/iosource/Manager.h"
+
+extern "C" {
+#include "zeek/setsignal.h"
+}
+
+namespace zeek::detail {
+
+SamplingProfiler sampling_profiler;
+
+volatile sig_atomic_t SamplingProfiler::script_depth = 0;
+volatile sig_atomic_t SamplingProfiler::toggle_requested = 0;
+std::atomic<int> SamplingProfiler::pending_samples{0};
+std::atomic<int> SamplingProfiler::pending_core_samples{0};
+
+// Only lock-free atomics may be used from a signal handler.
+static_assert(std::atomic<int>::is_always_lock_free);
+
+SamplingProfiler::~SamplingProfiler()
+	{
+	if ( running )
+		Stop();
+	}
+
+RETSIGTYPE SamplingProfiler::SignalHandler(int signo)
+	{
+	if ( script_depth > 0 )
+		pending_samples.fetch_add(1, std::memory_order_relaxed);
+	else
+		pending_core_samples.fetch_add(1, std::memory_order_relaxed);
+
+	return RETSIGVAL;
+	}
+
+RETSIGTYPE SamplingProfiler::ToggleHandler(int signo)
+	{
+	toggle_requested = 1;
+
+	if ( iosource_mgr )
+		iosource_mgr->Wakeup("SamplingProfiler");
+
+	return RETSIGVAL;
+	}
+
+bool SamplingProfiler::Start(std::string arg_file, double interval)
+	{
+	if ( running || interval <= 0 )
+		return false;
+
+	struct itimerval it;
+	it.it_interval.tv_sec = static_cast<time_t>(interval);
+	it.it_interval.tv_usec = static_cast<suseconds_t>((interval - it.it_interval.tv_sec) * 1e6);
+
+	if ( it.it_interval.tv_sec == 0 && it.it_interval.tv_usec == 0 )
+		it.it_interval.tv_usec = 1;
+
+	it.it_value = it.it_interval;
+
+	pending_samples = 0;
+	pending_core_samples = 0;
+	core_samples = 0;
+	stacks.clear();
+
+	setsignal(SIGPROF, SignalHandler);
+
+	if ( setitimer(ITIMER_PROF, &it, nullptr) < 0 )
+		{
+		reporter->Error("cannot start script profiling: %s", strerror(errno));
+		setsignal(SIGPROF, SIG_IGN);
+		return false;
+		}
+
+	file = std::move(arg_file);
+	running = true;
+	return true;
+	}
+
+bool SamplingProfiler::Stop()
+	{
+	if ( ! running )
+		return false;
+
+	struct itimerval it = {};
+	setitimer(ITIMER_PROF, &it, nullptr);
+
+	// A signal may still be in flight; ignore rather than restore the
+	// default action, which would terminate the process.
+	setsignal(SIGPROF, SIG_IGN);
+
+	running = false;
+	pending_samples = 0;
+	core_samples += pending_core_samples.exchange(0);
+
+	return WriteStacks();
+	}
+
+void SamplingProfiler::InstallToggleSignal()
+	{
+	setsignal(SIGUSR2, ToggleHandler);
+	}
+
+void SamplingProfiler::DoToggle()
+	{
+	toggle_requested = 0;
+
+	if ( running )
+		{
+		Stop();
+		return;
+		}
+
+	auto f = id::find_val("script_profiling_file")->AsStringVal()->ToStdString();
+	auto interval = id::find_val("script_profiling_interval")->AsInterval();
+	Start(std::move(f), interval);
+	}
+
+void SamplingProfiler::DoSample()
+	{
+	uint64_t n = pending_samples.exchange(0);
+
+	if ( ! running || g_frame_stack.empty() )
+		{
+		// Not inside a function body after all, e.g. while evaluating
+		// global initializations.
+		core_samples += n;
+		return;
+		}
+
+	std::string stack;
+
+	for ( const auto* f : g_frame_stack )
+		{
+		if ( ! stack.empty() )
+			stack += ';';
+
+		const auto* func = f->GetFunction();
+		stack += func ? func->Name() : "<unknown>";
+
+		const Obj* where = f->GetNextStmt();
+
+		if ( ! where )
+			where = func;
+
+		if ( where )
+			{
+			const auto* loc = where->GetLocationInfo();
+
+			if ( loc && loc->filename )
+				stack += util::fmt(" (%s:%d)", loc->filename, loc->first_line);
+			}
+		}
+
+	stacks[stack] += n;
+	}
+
+bool SamplingProfiler::WriteStacks()
+	{
+	FILE* f = fopen(file.c_str(), "w");
+
+	if ( ! f )
+		{
+		reporter->Error("cannot write script profile to %s: %s", file.c_str(),
+		                strerror(errno));
+		return false;
+		}
+
+	if ( core_samples > 0 )
+		fprintf(f, "[core] %" PRIu64 "\n", core_samples);
+
+	// Sort the output so that profiles of different runs are easy to diff.
+	std::map<std::string, uint64_t> sorted(stacks.begin(), stacks.end());
+
+	for ( const auto& [stack, count] : sorted )
+		fprintf(f, "%s %" PRIu64 "\n", stack.c_str(), count);
+
+	fclose(f);
+
+	stacks.clear();
+	core_samples = 0;
+	return true;
+	}
+
+} // namespace zeek::detail
@@ -0,0 +1,125 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include "zeek/zeek-config.h"
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace zeek::detail {
+
+class Frame;
+
+/**
+ * A statistical profiler attributing CPU time to script functions, event
+ * handlers and hooks, and the source locations executing within them.
+ *
+ * A SIGPROF interval timer fires after every sampling interval of CPU
+ * time consumed by the process. When no script code is running, the
+ * signal handler charges the sample to the core directly. Otherwise it
+ * only marks a sample as pending, and the interpreter records the
+ * current script stack at its next statement boundary. Stacks are
+ * written in the folded format understood by flamegraph.pl and similar
+ * tools.
+ *
+ * The timer measures the CPU time of the whole process, including that
+ * of the logging, Broker and other threads. Their time gets charged to
+ * whatever the main thread happens to be executing, so script costs look
+ * higher on busy multi-threaded setups.
+ *
+ * Statement boundaries are only visible in the interpreter's statement
+ * lists. Bodies compiled to ZAM don't have them, so their samples get
+ * recorded only when the function returns, charged to its location as a
+ * whole.
+ */
+class SamplingProfiler {
+public:
+	SamplingProfiler() = default;
+	~SamplingProfiler();
+
+	/**
+	 * Starts sampling.
+	 *
+	 * @param file the file to write the folded stacks to on Stop().
+	 * @param interval the CPU time between two samples, in seconds.
+	 * @return false if the profiler is already running or the interval
+	 *         timer couldn't be set up.
+	 */
+	bool Start(std::string file, double interval);
+
+	/**
+	 * Stops sampling and writes out the collected stacks.
+	 *
+	 * @return false if the profiler wasn't running or the output file
+	 *         couldn't be written.
+	 */
+	bool Stop();
+
+	bool IsRunning() const	{ return running; }
+
+	/**
+	 * Installs a signal handler for SIGUSR2 that toggles the profiler,
+	 * using script_profiling_file and script_profiling_interval.
+	 */
+	void InstallToggleSignal();
+
+	/**
+	 * Starts or stops the profiler if SIGUSR2 was received since the
+	 * last call. Called from the main loop.
+	 */
+	void ProcessToggleSignal()
+		{
+		if ( toggle_requested )
+			DoToggle();
+		}
+
+	/**
+	 * Records any pending samples against the current script stack.
+	 * Called by the interpreter between statements, so this must stay
+	 * cheap when nothing is pending.
+	 */
+	void Sample()
+		{
+		if ( pending_samples.load(std::memory_order_relaxed) )
+			DoSample();
+		}
+
+	/**
+	 * Tracks whether script code is currently executing, so that the
+	 * signal handler can charge samples taken outside of it to the core.
+	 */
+	void EnterScript()	{ ++script_depth; }
+	void LeaveScript()	{ --script_depth; }
+
+private:
+	static RETSIGTYPE SignalHandler(int signo);
+	static RETSIGTYPE ToggleHandler(int signo);
+
+	void DoSample();
+	void DoToggle();
+	bool WriteStacks();
+
+	static volatile sig_atomic_t script_depth;
+	static volatile sig_atomic_t toggle_requested;
+
+	// Samples taken by the signal handler that haven't been accounted
+	// for yet. The handler increments them while the main thread takes
+	// them out, so they need atomic read-modify-write operations.
+	static std::atomic<int> pending_samples;
+	static std::atomic<int> pending_core_samples;
+
+	bool running = false;
+	std::string file;
+	uint64_t core_samples = 0;
+
+	// Folded stacks and the number of samples taken in each.
+	std::unordered_map<std::string, uint64_t> stacks;
+};
+
+extern SamplingProfiler sampling_profiler;
+
+} // namespace zeek::detail
@@ -63,6 +63,15 @@ uint32_t SerializationFormat::EndWrite(char** data)
 	return rval;
 	}
 
+void SerializationFormat::RewindWrite(int pos)
+	{
+	if ( pos < 0 || pos > bytes_written )
+		return;
+
+	output_pos -= bytes_written - pos;
+	bytes_written = pos;
+	}
+
 bool SerializationFormat::ReadData(void* b, size_t count)
 	{
 	if ( input_pos + count > input_len )
@@ -82,10 +91,13 @@ bool SerializationFormat::ReadData(void* b, size_t count)
 bool SerializationFormat::WriteData(const void* b, size_t count)
 	{
 	// Increase buffer if necessary.
-	while ( output_pos + count > output_size )
-		output_size *= GROWTH_FACTOR;
+	if ( output_pos + count > output_size )
+		{
+		while ( output_pos + count > output_size )
+			output_size *= GROWTH_FACTOR;
 
-	output = (char*)util::safe_realloc(output, output_size);
+		output = (char*)util::safe_realloc(output, output_size);
+		}
 
 	memcpy(output + output_pos, b, count);
 	output_pos += count;
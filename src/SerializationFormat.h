@@ -82,6 +82,9 @@ public:
 	// Returns number of raw bytes written since last call to StartWrite().
 	int BytesWritten() const	{ return bytes_written; }
 
+	// Discards everything written after the given BytesWritten() value.
+	void RewindWrite(int pos);
+
 protected:
 	bool ReadData(void* buf, size_t count);
 	bool WriteData(const void* buf, size_t count);
@@ -0,0 +1,251 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+
+#include "zeek/ShuntTable.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "zeek/Event.h"
+#include "zeek/Hash.h"
+#include "zeek/IP.h"
+#include "zeek/NetVar.h"
+#include "zeek/RunState.h"
+#include "zeek/Val.h"
+#include "zeek/iosource/Manager.h"
+#include "zeek/iosource/PktSrc.h"
+
+namespace zeek::detail {
+
+// Width of the expiration buckets, in seconds.
+static constexpr double EXPIRE_BUCKET_WIDTH = 1.0;
+
+// Flow::bucket of flows not scheduled yet.
+static constexpr int64_t NO_BUCKET = std::numeric_limits<int64_t>::min();
+
+static int64_t expire_bucket(double t)
+	{
+	return static_cast<int64_t>(floor(t / EXPIRE_BUCKET_WIDTH));
+	}
+
+static_assert(sizeof(ConnKey) ==
+              2 * sizeof(in6_addr) + 2 * sizeof(uint16_t) + sizeof(TransportProto));
+
+size_t ShuntTable::KeyHash::operator()(const ConnKey& k) const
+	{
+	// Keyed, as the flows' endpoints are up to whoever sends the
+	// packets. ConnKey has no padding, so this covers just its fields.
+	return KeyedHash::Hash64(&k, sizeof(k));
+	}
+
+bool ShuntTable::Add(const IPAddr& orig, uint16_t orig_p, const IPAddr& resp, uint16_t resp_p,
+                     TransportProto proto, double timeout)
+	{
+	if ( proto != TRANSPORT_TCP && proto != TRANSPORT_UDP )
+		return false;
+
+	ConnKey key(orig, resp, orig_p, resp_p, proto, false);
+	auto i = flows.find(key);
+
+	if ( i != flows.end() )
+		{
+		i->second.timeout = timeout;
+		Schedule(key, &i->second);
+		return true;
+		}
+
+	Flow f;
+	f.orig_h = orig;
+	f.resp_h = resp;
+	f.orig_p = orig_p;
+	f.resp_p = resp_p;
+	f.proto = proto;
+	f.timeout = timeout;
+	f.start = f.last = run_state::network_time;
+	f.bucket = NO_BUCKET;
+
+	auto* ps = iosource_mgr->GetPktSrc();
+	f.in_pkt_src = ps && ps->ShuntFlow(key, timeout);
+
+	auto& nf = flows.emplace(key, std::move(f)).first->second;
+	Schedule(key, &nf);
+
+	if ( next_expire == 0.0 )
+		next_expire = run_state::network_time;
+
+	return true;
+	}
+
+bool ShuntTable::Remove(const IPAddr& orig, uint16_t orig_p, const IPAddr& resp, uint16_t resp_p,
+                        TransportProto proto)
+	{
+	auto i = flows.find(ConnKey(orig, resp, orig_p, resp_p, proto, false));
+
+	if ( i == flows.end() )
+		return false;
+
+	Report(i->second);
+	Erase(i);
+	return true;
+	}
+
+bool ShuntTable::Lookup(const std::unique_ptr<IP_Hdr>& ip, uint32_t len, uint32_t caplen)
+	{
+	if ( run_state::network_time >= next_expire )
+		Expire(run_state::network_time);
+
+	TransportProto proto;
+
+	switch ( ip->NextProto() ) {
+	case IPPROTO_TCP:
+		proto = TRANSPORT_TCP;
+		break;
+
+	case IPPROTO_UDP:
+		proto = TRANSPORT_UDP;
+		break;
+
+	default:
+		return false;
+	}
+
+	// The IP analyzer asks again once fragments have been reassembled.
+	if ( ip->IsFragment() || caplen < ip->HdrLen() + 4u )
+		return false;
+
+	// Both TCP and UDP start with the source and destination port.
+	const u_char* tp = ip->Payload();
+	uint16_t src_p, dst_p;
+	memcpy(&src_p, tp, sizeof(src_p));
+	memcpy(&dst_p, tp + 2, sizeof(dst_p));
+
+	IPAddr src = ip->SrcAddr();
+	IPAddr dst = ip->DstAddr();
+
+	auto i = flows.find(ConnKey(src, dst, src_p, dst_p, proto, false));
+
+	if ( i == flows.end() )
+		return false;
+
+	Flow& f = i->second;
+
+	if ( src_p == f.orig_p && src == f.orig_h )
+		{
+		++f.orig_pkts;
+		f.orig_bytes += len;
+		}
+	else
+		{
+		++f.resp_pkts;
+		f.resp_bytes += len;
+		}
+
+	f.last = run_state::network_time;
+	return true;
+	}
+
+void ShuntTable::Schedule(const ConnKey& key, Flow* f)
+	{
+	int64_t b = expire_bucket(f->last + f->timeout);
+
+	if ( b == f->bucket )
+		return;
+
+	f->bucket = b;
+	buckets[b].push_back(key);
+	}
+
+void ShuntTable::Expire(double t)
+	{
+	int64_t current = expire_bucket(t);
+	next_expire = (current + 1) * EXPIRE_BUCKET_WIDTH;
+
+	while ( ! buckets.empty() )
+		{
+		auto b = buckets.begin();
+
+		if ( b->first >= current )
+			break;
+
+		for ( const auto& key : b->second )
+			{
+			auto i = flows.find(key);
+
+			if ( i == flows.end() || i->second.bucket != b->first )
+				continue;
+
+			Flow& f = i->second;
+
+			if ( f.last == 0.0 )
+				{
+				// Shunted before the first packet; its idle time
+				// starts now.
+				f.start = f.last = t;
+				Schedule(key, &f);
+				continue;
+				}
+
+			if ( f.last + f.timeout > t )
+				{
+				// Saw packets since it got scheduled.
+				Schedule(key, &f);
+				continue;
+				}
+
+			Report(f);
+			Erase(i);
+			}
+
+		buckets.erase(b);
+		}
+	}
+
+void ShuntTable::Report(const Flow& f)
+	{
+	if ( ! shunt_expired )
+		return;
+
+	static auto shunt_stats = id::find_type<RecordType>("ShuntStats");
+
+	auto id_val = make_intrusive<RecordVal>(id::conn_id);
+	id_val->Assign(0, make_intrusive<AddrVal>(f.orig_h));
+	id_val->Assign(1, val_mgr->Port(ntohs(f.orig_p), f.proto));
+	id_val->Assign(2, make_intrusive<AddrVal>(f.resp_h));
+	id_val->Assign(3, val_mgr->Port(ntohs(f.resp_p), f.proto));
+
+	auto stats = make_intrusive<RecordVal>(shunt_stats);
+	stats->Assign(0, make_intrusive<TimeVal>(f.start));
+	stats->Assign(1, make_intrusive<TimeVal>(f.last));
+	stats->Assign(2, val_mgr->Count(f.orig_pkts));
+	stats->Assign(3, val_mgr->Count(f.orig_bytes));
+	stats->Assign(4, val_mgr->Count(f.resp_pkts));
+	stats->Assign(5, val_mgr->Count(f.resp_bytes));
+
+	event_mgr.Enqueue(shunt_expired, std::move(id_val), std::move(stats));
+	}
+
+ShuntTable::FlowMap::iterator ShuntTable::Erase(FlowMap::iterator i)
+	{
+	if ( i->second.in_pkt_src )
+		{
+		if ( auto* ps = iosource_mgr->GetPktSrc() )
+			ps->UnshuntFlow(i->first);
+		}
+
+	return flows.erase(i);
+	}
+
+void ShuntTable::Done()
+	{
+	for ( auto i = flows.begin(); i != flows.end(); )
+		{
+		Report(i->second);
+		i = Erase(i);
+		}
+
+	buckets.clear();
+	}
+
+} // namespace zeek::detail
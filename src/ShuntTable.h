@@ -0,0 +1,133 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "zeek/IPAddr.h"
+
+namespace zeek {
+
+class IP_Hdr;
+
+namespace detail {
+
+/**
+ * Tracks flows whose remaining packets the scripts aren't interested in.
+ * The IP analyzer asks the table about each packet right after parsing the
+ * IP header, and packets of shunted flows are counted and dropped there,
+ * before they reach session lookup and the connection's analyzers.
+ * Fragmented packets are asked about once reassembled, and count as one.
+ *
+ * A shunt expires once its flow has been idle for the shunt's timeout, at
+ * which point the shunt_expired event reports the packets dropped for it.
+ * Expiration works on buckets of one second, so a shunt may outlive its
+ * timeout by up to that much.
+ */
+class ShuntTable {
+public:
+	/**
+	 * Shunts a TCP or UDP flow. If the flow is shunted already, only its
+	 * timeout gets updated.
+	 *
+	 * @param orig The originator's address.
+	 *
+	 * @param orig_p The originator's port, in network byte order.
+	 *
+	 * @param resp The responder's address.
+	 *
+	 * @param resp_p The responder's port, in network byte order.
+	 *
+	 * @param proto The transport protocol, TRANSPORT_TCP or TRANSPORT_UDP.
+	 *
+	 * @param timeout The time the flow may remain idle before the shunt
+	 * expires.
+	 *
+	 * @return False if the protocol can't be shunted, else true.
+	 */
+	bool Add(const IPAddr& orig, uint16_t orig_p, const IPAddr& resp, uint16_t resp_p,
+	         TransportProto proto, double timeout);
+
+	/**
+	 * Removes a flow's shunt and reports its statistics. Both directions
+	 * of the flow are accepted.
+	 *
+	 * @return False if the flow isn't shunted, else true.
+	 */
+	bool Remove(const IPAddr& orig, uint16_t orig_p, const IPAddr& resp, uint16_t resp_p,
+	            TransportProto proto);
+
+	/**
+	 * Checks whether a packet belongs to a shunted flow, and accounts for
+	 * it if so.
+	 *
+	 * @param ip The packet's IP header.
+	 *
+	 * @param len The packet's length, as given in its IP header.
+	 *
+	 * @param caplen The number of bytes of the packet that were captured,
+	 * starting with the IP header.
+	 *
+	 * @return True if the packet should be dropped.
+	 */
+	bool NextPacket(const std::unique_ptr<IP_Hdr>& ip, uint32_t len, uint32_t caplen)
+		{ return ! flows.empty() && Lookup(ip, len, caplen); }
+
+	/**
+	 * Removes all shunts and reports their statistics. Called at
+	 * termination.
+	 */
+	void Done();
+
+	/**
+	 * Returns the number of flows currently shunted.
+	 */
+	size_t Size() const	{ return flows.size(); }
+
+private:
+	struct Flow {
+		IPAddr orig_h;
+		IPAddr resp_h;
+		uint16_t orig_p; // Network byte order.
+		uint16_t resp_p; // Network byte order.
+		TransportProto proto;
+		double timeout;
+		double start;
+		double last;
+		uint64_t orig_pkts = 0;
+		uint64_t orig_bytes = 0;
+		uint64_t resp_pkts = 0;
+		uint64_t resp_bytes = 0;
+		int64_t bucket; // The expiration bucket currently holding the flow.
+		bool in_pkt_src; // True if the packet source shunts the flow as well.
+	};
+
+	struct KeyHash {
+		size_t operator()(const ConnKey& k) const;
+	};
+
+	using FlowMap = std::unordered_map<ConnKey, Flow, KeyHash>;
+
+	bool Lookup(const std::unique_ptr<IP_Hdr>& ip, uint32_t len, uint32_t caplen);
+	void Schedule(const ConnKey& key, Flow* f);
+	void Expire(double t);
+	void Report(const Flow& f);
+	FlowMap::iterator Erase(FlowMap::iterator i);
+
+	FlowMap flows;
+
+	// Keys of shunted flows, grouped by the second in which they may
+	// expire. A flow's key may linger in buckets the flow has since
+	// moved out of; Flow::bucket tells which entry counts.
+	std::map<int64_t, std::vector<ConnKey>> buckets;
+	double next_expire = 0.0;
+};
+
+extern ShuntTable* shunt_table;
+
+} // namespace detail
+} // namespace zeek
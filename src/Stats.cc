@@ -15,7 +15,12 @@
 #include "zeek/broker/Manager.h"
 #include "zeek/input.h"
 #include "zeek/Func.h"
+#include "zeek/EventRegistry.h"
+#include "zeek/Reassem.h"
+#include "zeek/logging/Manager.h"
+#include "zeek/packet_analysis/Manager.h"
 #include "zeek/packet_analysis/protocol/tcp/TCP.h"
+#include "zeek/telemetry/Manager.h"
 
 uint64_t zeek::detail::killed_by_inactivity = 0;
 uint64_t& killed_by_inactivity = zeek::detail::killed_by_inactivity;
@@ -29,6 +34,9 @@ uint64_t& tot_gap_events = zeek::detail::tot_gap_events;
 uint64_t zeek::detail::tot_gap_bytes = 0;
 uint64_t& tot_gap_bytes = zeek::detail::tot_gap_bytes;
 
+uint64_t zeek::detail::tot_reassem_evictions = 0;
+uint64_t zeek::detail::tot_reassem_evicted_bytes = 0;
+
 namespace zeek::detail {
 
 class ProfileTimer final : public Timer {
@@ -433,6 +441,151 @@ void SegmentProfiler::Report()
 	reporter->SegmentProfile(name, loc, dtime, dmem);
 	}
 
+class CoreMetricsTimer final : public Timer {
+public:
+	CoreMetricsTimer(double t, CoreMetrics* m, double i)
+		: Timer(t, TIMER_CORE_METRICS), metrics(m), interval(i)
+		{ }
+
+	void Dispatch(double t, bool is_expire) override;
+
+protected:
+	CoreMetrics* metrics;
+	double interval;
+};
+
+void CoreMetricsTimer::Dispatch(double t, bool is_expire)
+	{
+	metrics->Update();
+
+	if ( ! is_expire )
+		timer_mgr->Add(new CoreMetricsTimer(run_state::network_time + interval,
+		                                    metrics, interval));
+	}
+
+// Advances a counter to the given running total.  Counters never go
+// down, so a total that restarted from zero is ignored until it catches
+// up again.
+template <class Counter, class T>
+static void sync_counter(Counter c, T total)
+	{
+	auto delta = static_cast<decltype(c.Value())>(total) - c.Value();
+
+	if ( delta > 0 )
+		c.Inc(delta);
+	}
+
+static void set_gauge(telemetry::IntGauge g, int64_t value)
+	{
+	auto delta = value - g.Value();
+
+	if ( delta > 0 )
+		g.Inc(delta);
+	else if ( delta < 0 )
+		g.Dec(-delta);
+	}
+
+CoreMetrics::CoreMetrics(double interval)
+	: analyzer_packets(telemetry_mgr->CounterFamily(
+		  "zeek", "packet-analyzer-packets", {"analyzer"},
+		  "Packets forwarded to each packet analyzer", "1", true)),
+	  event_queue_depth(telemetry_mgr->GaugeSingleton(
+		  "zeek", "event-queue-depth", "Events waiting to be dispatched")),
+	  events_dispatched(telemetry_mgr->CounterSingleton(
+		  "zeek", "dispatched-events", "Total number of dispatched events", "1", true)),
+	  handler_invocations(telemetry_mgr->CounterFamily(
+		  "zeek", "event-handler-invocations", {"name"},
+		  "Invocations of each event handler", "1", true)),
+	  handler_time(telemetry_mgr->CounterFamily<double>(
+		  "zeek", "event-handler-time", {"name"},
+		  "Time spent in each event handler, including nested dispatching",
+		  "seconds", true)),
+	  timers(telemetry_mgr->GaugeFamily(
+		  "zeek", "active-timers", {"type"}, "Pending timers by type")),
+	  reassembly_bytes(telemetry_mgr->GaugeFamily(
+		  "zeek", "reassembly-buffered-bytes", {"type"},
+		  "Data buffered by reassemblers", "bytes")),
+	  thread_pending_in(telemetry_mgr->GaugeFamily(
+		  "zeek", "thread-pending-in-messages", {"thread"},
+		  "Messages queued for each thread")),
+	  thread_pending_out(telemetry_mgr->GaugeFamily(
+		  "zeek", "thread-pending-out-messages", {"thread"},
+		  "Messages queued by each thread for the main thread")),
+	  log_writes(telemetry_mgr->CounterFamily(
+		  "zeek", "log-stream-writes", {"stream"},
+		  "Records written to each log stream", "1", true)),
+	  interned_strings(telemetry_mgr->GaugeFamily(
+		  "zeek", "interned-strings", {"type"},
+		  "Distinct strings shared for each kind of protocol field")),
+	  intern_hits(telemetry_mgr->CounterFamily(
+		  "zeek", "interned-string-hits", {"type"},
+		  "Field values that reused a shared string", "1", true)),
+	  intern_misses(telemetry_mgr->CounterFamily(
+		  "zeek", "interned-string-misses", {"type"},
+		  "Field values that needed a new string", "1", true)),
+	  intern_saved_bytes(telemetry_mgr->CounterFamily(
+		  "zeek", "interned-string-saved-bytes", {"type"},
+		  "Allocations avoided by reusing shared strings", "bytes", true))
+	{
+	timer_mgr->Add(new CoreMetricsTimer(1, this, interval));
+	}
+
+void CoreMetrics::Update()
+	{
+	for ( const auto& [name, analyzer] : packet_mgr->GetAnalyzers() )
+		{
+		if ( analyzer && analyzer->PacketsProcessed() > 0 )
+			sync_counter(analyzer_packets.GetOrAdd({{"analyzer", name}}),
+			             analyzer->PacketsProcessed());
+		}
+
+	set_gauge(event_queue_depth, event_mgr.Size());
+	sync_counter(events_dispatched, event_mgr.num_events_dispatched);
+
+	for ( const auto& name : event_registry->AllHandlers() )
+		{
+		auto h = event_registry->Lookup(name);
+
+		if ( ! h || h->CallCount() == 0 )
+			continue;
+
+		sync_counter(handler_invocations.GetOrAdd({{"name", name}}), h->CallCount());
+		sync_counter(handler_time.GetOrAdd({{"name", name}}), h->CallTime());
+		}
+
+	unsigned int* current_timers = TimerMgr::CurrentTimers();
+	for ( int i = 0; i < NUM_TIMER_TYPES; ++i )
+		set_gauge(timers.GetOrAdd({{"type", timer_type_to_string(static_cast<TimerType>(i))}}),
+		          current_timers[i]);
+
+	static const char* reassembler_types[REASSEM_NUM] = { "unknown", "tcp", "frag", "file" };
+
+	for ( int i = 0; i < REASSEM_NUM; ++i )
+		set_gauge(reassembly_bytes.GetOrAdd({{"type", reassembler_types[i]}}),
+		          Reassembler::BufferedBytes(static_cast<ReassemblerType>(i)));
+
+	for ( const auto& [name, s] : thread_mgr->GetMsgThreadStats() )
+		{
+		set_gauge(thread_pending_in.GetOrAdd({{"thread", name}}), s.pending_in);
+		set_gauge(thread_pending_out.GetOrAdd({{"thread", name}}), s.pending_out);
+		}
+
+	for ( const auto& [name, writes] : log_mgr->StreamWriteCounts() )
+		sync_counter(log_writes.GetOrAdd({{"stream", name}}), writes);
+
+	for ( int i = 0; i < INTERN_NUM; ++i )
+		{
+		auto type = static_cast<InternedStringType>(i);
+		auto name = ValManager::InternedStringTypeName(type);
+		auto s = val_mgr->GetInternStats(type);
+
+		set_gauge(interned_strings.GetOrAdd({{"type", name}}), s.entries);
+		sync_counter(intern_hits.GetOrAdd({{"type", name}}), s.hits);
+		sync_counter(intern_misses.GetOrAdd({{"type", name}}), s.misses);
+		sync_counter(intern_saved_bytes.GetOrAdd({{"type", name}}), s.saved_bytes);
+		}
+	}
+
 PacketProfiler::PacketProfiler(unsigned int mode, double freq,
                                File* arg_file)
 	{
@@ -9,6 +9,9 @@
 #include <sys/resource.h>
 #include <stdint.h>
 
+#include "zeek/telemetry/Counter.h"
+#include "zeek/telemetry/Gauge.h"
+
 namespace zeek {
 
 class File;
@@ -109,9 +112,38 @@ protected:
 };
 
 
+// Publishes statistics about the core's own activity as telemetry
+// metrics.  The hot paths only bump plain counters owned by the
+// respective subsystems, which CoreMetrics copies into the telemetry
+// handles once every core_metrics_interval.  That keeps the per-packet
+// and per-event overhead to a non-atomic increment.
+class CoreMetrics final {
+public:
+	explicit CoreMetrics(double interval);
+
+	void Update();
+
+private:
+	telemetry::IntCounterFamily analyzer_packets;
+	telemetry::IntGauge event_queue_depth;
+	telemetry::IntCounter events_dispatched;
+	telemetry::IntCounterFamily handler_invocations;
+	telemetry::DblCounterFamily handler_time;
+	telemetry::IntGaugeFamily timers;
+	telemetry::IntGaugeFamily reassembly_bytes;
+	telemetry::IntGaugeFamily thread_pending_in;
+	telemetry::IntGaugeFamily thread_pending_out;
+	telemetry::IntCounterFamily log_writes;
+	telemetry::IntGaugeFamily interned_strings;
+	telemetry::IntCounterFamily intern_hits;
+	telemetry::IntCounterFamily intern_misses;
+	telemetry::IntCounterFamily intern_saved_bytes;
+};
+
 extern ProfileLogger* profiling_logger;
 extern ProfileLogger* segment_logger;
 extern SampleLogger* sample_logger;
+extern CoreMetrics* core_metrics;
 
 // Connection statistics.
 extern uint64_t killed_by_inactivity;
@@ -122,6 +154,10 @@ extern uint64_t tot_ack_bytes;
 extern uint64_t tot_gap_events;
 extern uint64_t tot_gap_bytes;
 
+// Reassembly memory budget statistics.
+extern uint64_t tot_reassem_evictions;
+extern uint64_t tot_reassem_evicted_bytes;
+
 class PacketProfiler {
 public:
 	PacketProfiler(unsigned int mode, double freq, File* arg_file);
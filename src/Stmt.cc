@@ -10,6 +10,7 @@
 #include "zeek/Frame.h"
 #include "zeek/File.h"
 #include "zeek/Reporter.h"
+#include "zeek/SamplingProfiler.h"
 #include "zeek/NetVar.h"
 #include "zeek/Scope.h"
 #include "zeek/Var.h"
@@ -1633,6 +1634,8 @@ ValPtr StmtList::Exec(Frame* f, StmtFlowType& flow)
 			{ // ### Abort or something
 			}
 
+		sampling_profiler.Sample();
+
 		if ( flow != FLOW_NEXT || result || f->HasDelayed() )
 			return result;
 		}
@@ -48,6 +48,7 @@ const char* TimerNames[] = {
 	"TimerMgrExpireTimer",
 	"ThreadHeartbeat",
 	"UnknownProtocolExpire",
+	"CoreMetricsTimer",
 };
 
 const char* timer_type_to_string(TimerType type)
@@ -413,7 +413,7 @@ TableValPtr Val::GetRecordFields()
 	}
 
 // This is a static method in this file to avoid including rapidjson's headers in Val.h because they're huge.
-static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val* val,
+static void BuildJSON(threading::formatter::JSONWriter& writer, Val* val,
                       bool only_loggable=false, RE_Matcher* re=nullptr, const string& key="")
 	{
 	if ( !key.empty() )
@@ -426,8 +426,6 @@ static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val*
 		return;
 		}
 
-	rapidjson::Value j;
-
 	switch ( val->GetType()->Tag() )
 		{
 		case TYPE_BOOL:
@@ -462,9 +460,46 @@ static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val*
 			break;
 			}
 
+		case TYPE_ADDR:
+			{
+			const auto& addr = val->AsAddr();
+
+			if ( addr.GetFamily() == IPv4 )
+				{
+				in_addr a;
+				addr.CopyIPv4(&a);
+				writer.Addr(a);
+				}
+			else
+				{
+				in6_addr a;
+				addr.CopyIPv6(&a);
+				writer.Addr(a);
+				}
+
+			break;
+			}
+
+		case TYPE_STRING:
+			{
+			const auto* str = val->AsString();
+			writer.StringUTF8(reinterpret_cast<const char*>(str->Bytes()), str->Len());
+			break;
+			}
+
+		case TYPE_ENUM:
+			{
+			const char* name = val->GetType()->AsEnumType()->Lookup(val->AsEnum());
+
+			if ( ! name )
+				name = "<undefined>";
+
+			writer.StringUTF8(name, strlen(name));
+			break;
+			}
+
 		case TYPE_PATTERN:
 		case TYPE_INTERVAL:
-		case TYPE_ADDR:
 		case TYPE_SUBNET:
 			{
 			ODesc d;
@@ -476,13 +511,11 @@ static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val*
 
 		case TYPE_FILE:
 		case TYPE_FUNC:
-		case TYPE_ENUM:
-		case TYPE_STRING:
 			{
 			ODesc d;
 			d.SetStyle(RAW_STYLE);
 			val->Describe(&d);
-			writer.String(util::json_escape_utf8(std::string(reinterpret_cast<const char*>(d.Bytes()), d.Len())));
+			writer.StringUTF8(reinterpret_cast<const char*>(d.Bytes()), d.Len());
 			break;
 			}
 
@@ -498,6 +531,7 @@ static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val*
 
 			std::unique_ptr<detail::HashKey> k;
 			TableEntryVal* entry;
+			threading::formatter::JSONWriter key_writer;
 
 			for ( const auto& te : *table )
 				{
@@ -511,10 +545,9 @@ static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val*
 					BuildJSON(writer, entry_key, only_loggable, re);
 				else
 					{
-					rapidjson::StringBuffer buffer;
-					threading::formatter::JSON::NullDoubleWriter key_writer(buffer);
+					key_writer.Clear();
 					BuildJSON(key_writer, entry_key, only_loggable, re);
-					string key_str = buffer.GetString();
+					string key_str = key_writer.Str();
 
 					if ( key_str.length() >= 2 &&
 					     key_str[0] == '"' &&
@@ -615,12 +648,20 @@ static void BuildJSON(threading::formatter::JSON::NullDoubleWriter& writer, Val*
 
 StringValPtr Val::ToJSON(bool only_loggable, RE_Matcher* re)
 	{
-	rapidjson::StringBuffer buffer;
-	threading::formatter::JSON::NullDoubleWriter writer(buffer);
+	// Reused to keep its buffer. BuildJSON() doesn't call back into
+	// scripts, so there's no reentrancy.
+	static threading::formatter::JSONWriter writer;
+	writer.Clear();
 
 	BuildJSON(writer, this, only_loggable, re, "");
 
-	return make_intrusive<StringVal>(buffer.GetString());
+	auto rval = make_intrusive<StringVal>(writer.Len(), writer.Data());
+
+	// Don't hold on to the memory of an occasional huge value.
+	if ( writer.Capacity() > 65536 )
+		writer.Reset();
+
+	return rval;
 	}
 
 void IntervalVal::ValDescribe(ODesc* d) const
@@ -1995,9 +2036,11 @@ VectorValPtr TableVal::LookupSubnets(const SubNetVal* search)
 
 	auto result = make_intrusive<VectorVal>(id::find_type<VectorType>("subnet_vec"));
 
-	auto matches = subnets->FindAll(search);
-	for ( auto element : matches )
-		result->Assign(result->Size(), make_intrusive<SubNetVal>(get<0>(element)));
+	const auto& sn = search->AsSubNet();
+	subnets->ForEachMatch(sn.Prefix(), sn.LengthIPv6(), [&result](const IPPrefix& prefix, void*)
+		{
+		result->Assign(result->Size(), make_intrusive<SubNetVal>(prefix));
+		});
 
 	return result;
 	}
@@ -2009,11 +2052,11 @@ TableValPtr TableVal::LookupSubnetValues(const SubNetVal* search)
 
 	auto nt = make_intrusive<TableVal>(this->GetType<TableType>());
 
-	auto matches = subnets->FindAll(search);
-	for ( auto element : matches )
+	const auto& sn = search->AsSubNet();
+	subnets->ForEachMatch(sn.Prefix(), sn.LengthIPv6(), [this, &nt](const IPPrefix& prefix, void* data)
 		{
-		auto s = make_intrusive<SubNetVal>(get<0>(element));
-		TableEntryVal* entry = reinterpret_cast<TableEntryVal*>(get<1>(element));
+		auto s = make_intrusive<SubNetVal>(prefix);
+		TableEntryVal* entry = reinterpret_cast<TableEntryVal*>(data);
 
 		if ( entry && entry->GetVal() )
 			nt->Assign(std::move(s), entry->GetVal());
@@ -2025,7 +2068,7 @@ TableValPtr TableVal::LookupSubnetValues(const SubNetVal* search)
 			if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
 				entry->SetExpireAccess(run_state::network_time);
 			}
-		}
+		});
 
 	return nt;
 	}
@@ -4095,4 +4138,90 @@ const PortValPtr& ValManager::Port(uint32_t port_num) const
 		return Port(port_num, TRANSPORT_UNKNOWN);
 	}
 
+StringValPtr ValManager::InternedString(InternedStringType type, const char* s, int len)
+	{
+	if ( detail::string_intern_max_entries == 0 ||
+	     len > static_cast<int>(detail::string_intern_max_length) )
+		return make_intrusive<StringVal>(len, s);
+
+	auto& pool = intern_pools[type];
+	auto i = pool.strings.find(std::string_view(s, len));
+
+	if ( i != pool.strings.end() )
+		{
+		++pool.stats.hits;
+		pool.stats.saved_bytes += sizeof(StringVal) + sizeof(String) + len + 1;
+		i->second.used = true;
+		return i->second.val;
+		}
+
+	++pool.stats.misses;
+	auto v = make_intrusive<StringVal>(len, s);
+
+	if ( pool.strings.size() >= detail::string_intern_max_entries &&
+	     ! SweepInterned(&pool) )
+		return v;
+
+	// The key points into the value, which doesn't change.
+	auto b = v->Get();
+	pool.strings.emplace(std::string_view(reinterpret_cast<const char*>(b->Bytes()), b->Len()),
+	                     InternEntry{v, false});
+
+	return v;
+	}
+
+bool ValManager::SweepInterned(InternPool* pool)
+	{
+	// A pool full of values that are all still in use would otherwise
+	// get swept with every miss.
+	if ( pool->sweep_delay > 0 )
+		{
+		--pool->sweep_delay;
+		return false;
+		}
+
+	for ( auto i = pool->strings.begin(); i != pool->strings.end(); )
+		{
+		auto& e = i->second;
+
+		if ( ! e.used && e.val->RefCnt() == 1 )
+			{
+			++pool->stats.evictions;
+			i = pool->strings.erase(i);
+			}
+		else
+			{
+			e.used = false;
+			++i;
+			}
+		}
+
+	if ( pool->strings.size() < detail::string_intern_max_entries )
+		return true;
+
+	pool->sweep_delay = detail::string_intern_max_entries;
+	return false;
+	}
+
+ValManager::InternStats ValManager::GetInternStats(InternedStringType type) const
+	{
+	auto s = intern_pools[type].stats;
+	s.entries = intern_pools[type].strings.size();
+	return s;
+	}
+
+const char* ValManager::InternedStringTypeName(InternedStringType type)
+	{
+	static const char* names[INTERN_NUM] = {
+		"http-method",
+		"http-host",
+		"http-user-agent",
+		"mime-type",
+		"ssl-sni",
+		"dns-query",
+	};
+
+	return names[type];
+	}
+
 }
@@ -6,6 +6,7 @@
 #include <vector>
 #include <list>
 #include <array>
+#include <string_view>
 #include <unordered_map>
 
 #include "zeek/IntrusivePtr.h"
@@ -264,6 +265,18 @@ protected:
 
 };
 
+// Kinds of strings that analyzers share across events through
+// ValManager::InternedString().  Each kind has a pool of its own.
+enum InternedStringType {
+	INTERN_HTTP_METHOD,
+	INTERN_HTTP_HOST,
+	INTERN_HTTP_USER_AGENT,
+	INTERN_MIME_TYPE,
+	INTERN_SSL_SNI,
+	INTERN_DNS_QUERY,
+	INTERN_NUM,
+};
+
 // Holds pre-allocated Val objects for those where it's more optimal to
 // re-use existing ones rather than allocate anew.
 class ValManager {
@@ -306,7 +319,53 @@ public:
 	// Host-order port number already masked with port space protocol mask.
 	const PortValPtr& Port(uint32_t port_num) const;
 
+	/**
+	 * Returns a string value holding the given bytes.  Short values get
+	 * shared with earlier calls for the same type of string, which saves
+	 * allocations for values that keep coming back, like HTTP methods.
+	 * Callers must hence not modify the result.
+	 *
+	 * At most string_intern_max_entries values of a type are kept.  Once
+	 * a type's pool is full, values that haven't been asked for recently
+	 * and aren't used elsewhere make room for new ones.
+	 */
+	StringValPtr InternedString(InternedStringType type, const char* s, int len);
+
+	StringValPtr InternedString(InternedStringType type, const std::string& s)
+		{ return InternedString(type, s.data(), s.size()); }
+
+	struct InternStats {
+		uint64_t entries;	// values currently kept
+		uint64_t hits;	// values shared
+		uint64_t misses;	// values allocated anew
+		uint64_t evictions;	// values dropped to make room
+		uint64_t saved_bytes;	// bytes the hits didn't need to allocate
+	};
+
+	InternStats GetInternStats(InternedStringType type) const;
+
+	static const char* InternedStringTypeName(InternedStringType type);
+
 private:
+	struct InternEntry {
+		StringValPtr val;
+		bool used;	// asked for since the last sweep
+	};
+
+	struct InternPool {
+		// Field values are up to whoever sends the traffic, hence the
+		// keyed hash.
+		std::unordered_map<std::string_view, InternEntry, detail::KeyedStringHash> strings;
+		InternStats stats = {};
+
+		// Misses to let pass before sweeping again, after a sweep
+		// that didn't make room.
+		uint64_t sweep_delay = 0;
+	};
+
+	bool SweepInterned(InternPool* pool);
+
+	std::array<InternPool, INTERN_NUM> intern_pools;
 
 	std::array<std::array<PortValPtr, 65536>, NUM_PORT_SPACES> ports;
 	std::array<ValPtr, PREALLOCATED_COUNTS> counts;
@@ -2,6 +2,8 @@
 
 #include "zeek/analyzer/Manager.h"
 
+#include <cmath>
+
 #include "zeek/Hash.h"
 #include "zeek/Val.h"
 #include "zeek/IntrusivePtr.h"
@@ -19,6 +21,16 @@
 
 namespace zeek::analyzer {
 
+// Width of the timeout buckets of scheduled analyzers, in seconds. Entries
+// may linger for up to this long after their timeout before they are
+// removed, but GetScheduled() ignores them by then.
+static constexpr double SCHEDULED_TIMEOUT_BUCKET_WIDTH = 1.0;
+
+static int64_t timeout_bucket(double t)
+	{
+	return static_cast<int64_t>(floor(t / SCHEDULED_TIMEOUT_BUCKET_WIDTH));
+	}
+
 Manager::ConnIndex::ConnIndex(const IPAddr& _orig, const IPAddr& _resp,
                               uint16_t _resp_p, uint16_t _proto)
 	{
@@ -58,6 +70,24 @@ bool Manager::ConnIndex::operator<(const ConnIndex& other) const
 	return false;
 	}
 
+bool Manager::ConnIndex::operator==(const ConnIndex& other) const
+	{
+	return resp_p == other.resp_p && proto == other.proto &&
+	       orig == other.orig && resp == other.resp;
+	}
+
+size_t Manager::ConnIndex::Hash::operator()(const ConnIndex& c) const
+	{
+	// The endpoints usually come from negotiations in control channels,
+	// such as FTP's PORT commands, and thus from the remote side.
+	uint32_t words[9];
+	c.orig.CopyIPv6(&words[0]);
+	c.resp.CopyIPv6(&words[4]);
+	words[8] = (static_cast<uint32_t>(c.proto) << 16) | c.resp_p;
+
+	return zeek::detail::KeyedHash::Hash64(words, sizeof(words));
+	}
+
 Manager::Manager()
 	: plugin::ComponentManager<analyzer::Tag, analyzer::Component>("Analyzer", "Tag")
 	{
@@ -66,12 +96,8 @@ Manager::Manager()
 Manager::~Manager()
 	{
 	// Clean up expected-connection table.
-	while ( conns_by_timeout.size() )
-		{
-		ScheduledAnalyzer* a = conns_by_timeout.top();
-		conns_by_timeout.pop();
+	for ( auto& [c, a] : conns )
 		delete a;
-		}
 	}
 
 void Manager::InitPostScript()
@@ -267,8 +293,11 @@ bool Manager::UnregisterAnalyzerForPort(const Tag& tag, TransportProto proto, ui
 
 Analyzer* Manager::InstantiateAnalyzer(const Tag& tag, Connection* conn)
 	{
-	Component* c = Lookup(tag);
+	return InstantiateAnalyzer(Lookup(tag), conn);
+	}
 
+Analyzer* Manager::InstantiateAnalyzer(const Component* c, Connection* conn)
+	{
 	if ( ! c )
 		{
 		reporter->InternalWarning("request to instantiate unknown analyzer");
@@ -281,7 +310,7 @@ Analyzer* Manager::InstantiateAnalyzer(const Tag& tag, Connection* conn)
 	if ( ! c->Factory() )
 		{
 		reporter->InternalWarning("analyzer %s cannot be instantiated dynamically",
-					  GetComponentName(tag).c_str());
+					  c->CanonicalName().c_str());
 		return nullptr;
 		}
 
@@ -293,7 +322,7 @@ Analyzer* Manager::InstantiateAnalyzer(const Tag& tag, Connection* conn)
 		return nullptr;
 		}
 
-	a->SetAnalyzerTag(tag);
+	a->SetAnalyzerTag(c->Tag());
 
 	return a;
 	}
@@ -309,36 +338,45 @@ void Manager::ExpireScheduledAnalyzers()
 	if ( ! run_state::network_time )
 		return;
 
-	while ( conns_by_timeout.size() )
+	// Only buckets whose entries have all timed out are removed.
+	int64_t current = timeout_bucket(run_state::network_time);
+
+	while ( ! conns_by_timeout.empty() )
 		{
-		ScheduledAnalyzer* a = conns_by_timeout.top();
+		auto b = conns_by_timeout.begin();
 
-		if ( a->timeout > run_state::network_time )
+		if ( b->first >= current )
 			return;
 
-		conns_by_timeout.pop();
+		for ( ScheduledAnalyzer* a : b->second )
+			{
+			auto all = conns.equal_range(a->conn);
+
+			bool found = false;
 
-		std::pair<conns_map::iterator, conns_map::iterator> all = conns.equal_range(a->conn);
+			for ( auto i = all.first; i != all.second; i++ )
+				{
+				if ( i->second != a )
+					continue;
 
-		bool found = false;
+				conns.erase(i);
 
-		for ( conns_map::iterator i = all.first; i != all.second; i++ )
-			{
-			if ( i->second != a )
-				continue;
+				if ( a->conn.orig == IPAddr::v6_unspecified )
+					--num_wildcard_conns;
 
-			conns.erase(i);
+				DBG_LOG(DBG_ANALYZER, "Expiring expected analyzer %s for connection %s",
+				        analyzer_mgr->GetComponentName(a->analyzer).c_str(),
+				        fmt_conn_id(a->conn.orig, 0, a->conn.resp, a->conn.resp_p));
 
-			DBG_LOG(DBG_ANALYZER, "Expiring expected analyzer %s for connection %s",
-			        analyzer_mgr->GetComponentName(a->analyzer).c_str(),
-			        fmt_conn_id(a->conn.orig, 0, a->conn.resp, a->conn.resp_p));
+				delete a;
+				found = true;
+				break;
+				}
 
-			delete a;
-			found = true;
-			break;
+			assert(found);
 			}
 
-		assert(found);
+		conns_by_timeout.erase(b);
 		}
 	}
 
@@ -364,7 +402,10 @@ void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp,
 	a->timeout = run_state::network_time + timeout;
 
 	conns.insert(std::make_pair(a->conn, a));
-	conns_by_timeout.push(a);
+	conns_by_timeout[timeout_bucket(a->timeout)].push_back(a);
+
+	if ( a->conn.orig == IPAddr::v6_unspecified )
+		++num_wildcard_conns;
 	}
 
 void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp,
@@ -386,26 +427,36 @@ void Manager::ScheduleAnalyzer(const IPAddr& orig, const IPAddr& resp, PortVal*
 	                        Tag(std::move(ev)), timeout);
 	}
 
-Manager::tag_set Manager::GetScheduled(const Connection* conn)
+void Manager::CollectScheduled(const ConnIndex& c, tag_set* result)
 	{
-	ConnIndex c(conn->OrigAddr(), conn->RespAddr(),
-		    ntohs(conn->RespPort()), conn->ConnTransport());
+	auto all = conns.equal_range(c);
 
-	std::pair<conns_map::iterator, conns_map::iterator> all = conns.equal_range(c);
+	for ( auto i = all.first; i != all.second; i++ )
+		{
+		if ( i->second->timeout > run_state::network_time )
+			result->insert(i->second->analyzer);
+		}
+	}
 
+Manager::tag_set Manager::GetScheduled(const Connection* conn)
+	{
 	tag_set result;
 
-	for ( conns_map::iterator i = all.first; i != all.second; i++ )
-		result.insert(i->second->analyzer);
+	if ( conns.empty() )
+		return result;
 
-	// Try wildcard for originator.
-	c.orig = IPAddr::v6_unspecified;
-	all = conns.equal_range(c);
+	ExpireScheduledAnalyzers();
 
-	for ( conns_map::iterator i = all.first; i != all.second; i++ )
+	ConnIndex c(conn->OrigAddr(), conn->RespAddr(),
+		    ntohs(conn->RespPort()), conn->ConnTransport());
+
+	CollectScheduled(c, &result);
+
+	// Try wildcard for originator.
+	if ( num_wildcard_conns > 0 )
 		{
-		if ( i->second->timeout > run_state::network_time )
-			result.insert(i->second->analyzer);
+		c.orig = IPAddr::v6_unspecified;
+		CollectScheduled(c, &result);
 		}
 
 	// We don't delete scheduled analyzers here. They will be expired
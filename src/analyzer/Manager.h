@@ -20,7 +20,8 @@
  */
 #pragma once
 
-#include <queue>
+#include <map>
+#include <unordered_map>
 #include <vector>
 
 #include "zeek/analyzer/Analyzer.h"
@@ -240,6 +241,22 @@ public:
 	 */
 	Analyzer* InstantiateAnalyzer(const char* name, Connection* c);
 
+	/**
+	 * Instantiates a new analyzer instance for a connection from an
+	 * already looked-up component. This saves the tag lookup when the
+	 * same analyzers get instantiated over and over, such as for
+	 * well-known ports.
+	 *
+	 * @param c The analyzer's component, or null for an unknown analyzer,
+	 * which gets reported like an unknown tag.
+	 *
+	 * @param conn The connection the analyzer is to be associated with.
+	 *
+	 * @return The new analyzer instance, or null if the analyzer is
+	 * unknown, disabled or can't be instantiated.
+	 */
+	Analyzer* InstantiateAnalyzer(const Component* c, Connection* conn);
+
 	/**
 	 * Schedules a particular analyzer for an upcoming connection. Once
 	 * the connection is seen, BuildInitAnalyzerTree() will add the
@@ -357,6 +374,11 @@ private:
 		ConnIndex();
 
 		bool operator<(const ConnIndex& other) const;
+		bool operator==(const ConnIndex& other) const;
+
+		struct Hash {
+			size_t operator()(const ConnIndex& c) const;
+		};
 	};
 
 	// Information associated with a scheduled connection.
@@ -364,21 +386,20 @@ private:
 		ConnIndex conn;
 		Tag analyzer;
 		double timeout;
-
-		struct Comparator {
-			bool operator() (ScheduledAnalyzer* a, ScheduledAnalyzer* b) {
-				return a->timeout > b->timeout;
-			}
-		};
 	};
 
-	using conns_map = std::multimap<ConnIndex, ScheduledAnalyzer*>;
-	using conns_queue = std::priority_queue<ScheduledAnalyzer*,
-	                                        std::vector<ScheduledAnalyzer*>,
-	                                        ScheduledAnalyzer::Comparator>;
+	using conns_map = std::unordered_multimap<ConnIndex, ScheduledAnalyzer*, ConnIndex::Hash>;
+
+	// Scheduled analyzers grouped by the interval of
+	// SCHEDULED_TIMEOUT_BUCKET_WIDTH seconds in which they time out, so
+	// that expiration can remove them a whole bucket at a time.
+	using conns_buckets = std::map<int64_t, std::vector<ScheduledAnalyzer*>>;
+
+	void CollectScheduled(const ConnIndex& c, tag_set* result);
 
 	conns_map conns;
-	conns_queue conns_by_timeout;
+	conns_buckets conns_by_timeout;
+	size_t num_wildcard_conns = 0; // Entries without originator address.
 	std::vector<uint16_t> vxlan_ports;
 };
 
@@ -240,7 +240,8 @@ bool DNS_Interpreter::ParseAnswer(detail::DNS_MsgInfo* msg,
 	// Note that the exact meaning of some of these fields will be
 	// re-interpreted by other, more adventurous RR types.
 
-	msg->query_name = make_intrusive<StringVal>(new String(name, name_end - name, true));
+	msg->query_name = val_mgr->InternedString(INTERN_DNS_QUERY, reinterpret_cast<const char*>(name),
+	                                          name_end - name);
 	msg->atype = detail::RR_Type(ExtractShort(data, len));
 	msg->aclass = ExtractShort(data, len);
 	msg->ttl = ExtractLong(data, len);
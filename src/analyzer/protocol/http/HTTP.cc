@@ -1253,7 +1253,7 @@ int HTTP_Analyzer::HTTP_RequestLine(const char* line, const char* end_of_line)
 		return -1;
 		}
 
-	request_method = make_intrusive<StringVal>(end_of_method - line, line);
+	request_method = val_mgr->InternedString(INTERN_HTTP_METHOD, line, end_of_method - line);
 
 	Conn()->Match(zeek::detail::Rule::HTTP_REQUEST,
 			(const u_char*) unescaped_URI->AsString()->Bytes(),
@@ -1649,12 +1649,23 @@ void HTTP_Analyzer::HTTP_Header(bool is_orig, analyzer::mime::MIME_Header* h)
 		auto upper_hn = analyzer::mime::to_string_val(h->get_name());
 		upper_hn->ToUpper();
 
+		// Host and User-Agent repeat a lot across requests.
+		StringValPtr value;
+
+		if ( analyzer::mime::istrequal(h->get_name(), "host") )
+			value = val_mgr->InternedString(INTERN_HTTP_HOST, hd_value.data, hd_value.length);
+		else if ( analyzer::mime::istrequal(h->get_name(), "user-agent") )
+			value = val_mgr->InternedString(INTERN_HTTP_USER_AGENT, hd_value.data,
+			                                hd_value.length);
+		else
+			value = analyzer::mime::to_string_val(hd_value);
+
 		EnqueueConnEvent(http_header,
 			ConnVal(),
 			val_mgr->Bool(is_orig),
 			analyzer::mime::to_string_val(h->get_name()),
 			std::move(upper_hn),
-			analyzer::mime::to_string_val(h->get_value())
+			std::move(value)
 		);
 		}
 	}
@@ -10,6 +10,7 @@
 #include "zeek/ZeekString.h"
 #include "zeek/Reporter.h"
 #include "zeek/RuleMatcher.h"
+#include "zeek/Stats.h"
 
 #include "zeek/analyzer/protocol/tcp/events.bif.h"
 
@@ -21,6 +22,9 @@ constexpr bool DEBUG_tcp_contents = false;
 constexpr bool DEBUG_tcp_connection_close = false;
 constexpr bool DEBUG_tcp_match_undelivered = false;
 
+std::list<TCP_Reassembler*> TCP_Reassembler::buffering;
+bool TCP_Reassembler::enforcing_budget = false;
+
 TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
                                  packet_analysis::TCP::TCPSessionAdapter* arg_tcp_analyzer,
                                  TCP_Reassembler::Type arg_type,
@@ -37,6 +41,7 @@ TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
 	did_EOF = false;
 	seq_to_skip = 0;
 	in_delivery = false;
+	is_buffering = false;
 
 	if ( zeek::detail::tcp_max_old_segments )
 		SetMaxOldBlocks(zeek::detail::tcp_max_old_segments);
@@ -59,6 +64,11 @@ TCP_Reassembler::TCP_Reassembler(analyzer::Analyzer* arg_dst_analyzer,
 		}
 	}
 
+TCP_Reassembler::~TCP_Reassembler()
+	{
+	StopBuffering();
+	}
+
 void TCP_Reassembler::Done()
 	{
 	MatchUndelivered(-1, true);
@@ -522,9 +532,86 @@ bool TCP_Reassembler::DataSent(double t, uint64_t seq, int len,
 		skip_deliveries = true;
 		}
 
+	if ( ! HoldsData() )
+		// Delivered everything, so we're not holding on to anything
+		// old anymore.
+		StopBuffering();
+
+	else if ( zeek::detail::tcp_reassembly_memory_budget )
+		{
+		if ( ! is_buffering )
+			StartBuffering();
+
+		if ( sizes[REASSEM_TCP] > zeek::detail::tcp_reassembly_memory_budget )
+			EnforceMemoryBudget();
+		}
+
 	return true;
 	}
 
+void TCP_Reassembler::StartBuffering()
+	{
+	buffering_pos = buffering.insert(buffering.end(), this);
+	is_buffering = true;
+	}
+
+void TCP_Reassembler::StopBuffering()
+	{
+	if ( ! is_buffering )
+		return;
+
+	buffering.erase(buffering_pos);
+	is_buffering = false;
+	}
+
+void TCP_Reassembler::EnforceMemoryBudget()
+	{
+	// Evicting delivers data, which in turn may feed other reassemblers
+	// (e.g., for tunnels). Leave it to the outermost call.
+	if ( enforcing_budget )
+		return;
+
+	enforcing_budget = true;
+
+	while ( sizes[REASSEM_TCP] > zeek::detail::tcp_reassembly_memory_budget )
+		{
+		// Look for the oldest one anew each time: evicting delivers
+		// data, which may make others drain and leave the list. Only
+		// the few up the current delivery stack get skipped.
+		auto it = std::find_if(buffering.begin(), buffering.end(),
+		                       [](const TCP_Reassembler* r) { return ! r->in_delivery; });
+
+		if ( it == buffering.end() )
+			break;
+
+		TCP_Reassembler* r = *it;
+		r->StopBuffering();
+
+		if ( ! r->HoldsData() )
+			continue;
+
+		uint64_t released = r->Evict();
+		r->tcp_analyzer->Weird("reassembly_memory_budget_exceeded");
+
+		++zeek::detail::tot_reassem_evictions;
+		zeek::detail::tot_reassem_evicted_bytes += released;
+		}
+
+	enforcing_budget = false;
+	}
+
+uint64_t TCP_Reassembler::Evict()
+	{
+	uint64_t size = block_list.DataSize() + old_block_list.DataSize();
+
+	if ( HasBlocks() )
+		TrimToSeq(block_list.LastBlock().upper);
+
+	ClearOldBlocks();
+
+	return size;
+	}
+
 
 void TCP_Reassembler::AckReceived(uint64_t seq)
 	{
@@ -542,6 +629,9 @@ void TCP_Reassembler::AckReceived(uint64_t seq)
 
 	uint64_t num_missing = TrimToSeq(seq);
 
+	if ( ! HoldsData() )
+		StopBuffering();
+
 	if ( test_active )
 		{
 		++zeek::detail::tot_ack_events;
@@ -640,7 +730,12 @@ void TCP_Reassembler::SkipToSeq(uint64_t seq)
 		{
 		seq_to_skip = seq;
 		if ( ! in_delivery )
+			{
 			TrimToSeq(seq);
+
+			if ( ! HoldsData() )
+				StopBuffering();
+			}
 		}
 	}
 
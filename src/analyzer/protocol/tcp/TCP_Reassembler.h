@@ -1,5 +1,7 @@
 #pragma once
 
+#include <list>
+
 #include "zeek/Reassem.h"
 #include "zeek/analyzer/protocol/tcp/TCP_Endpoint.h"
 #include "zeek/analyzer/protocol/tcp/TCP_Flags.h"
@@ -30,6 +32,8 @@ public:
 	                packet_analysis::TCP::TCPSessionAdapter* arg_tcp_analyzer,
 	                Type arg_type, TCP_Endpoint* arg_endp);
 
+	~TCP_Reassembler() override;
+
 	void Done();
 
 	void SetDstAnalyzer(analyzer::Analyzer* analyzer)	{ dst_analyzer = analyzer; }
@@ -88,8 +92,25 @@ public:
 	bool IsSkippedContents(uint64_t seq, int length) const
 		{ return seq + length <= seq_to_skip; }
 
+	// Makes reassemblers skip past the data they have buffered until
+	// all TCP reassemblers together hold no more than
+	// tcp_reassembly_memory_budget bytes. The ones that started
+	// buffering first go first.
+	static void EnforceMemoryBudget();
+
 private:
 
+	// Skips past everything buffered, delivering what's in front of
+	// the holes and reporting the holes as content gaps.  Returns the
+	// number of bytes released.
+	uint64_t Evict();
+
+	bool HoldsData() const
+		{ return ! block_list.Empty() || ! old_block_list.Empty(); }
+
+	void StartBuffering();
+	void StopBuffering();
+
 	void Undelivered(uint64_t up_to_seq) override;
 	void Gap(uint64_t seq, uint64_t len);
 
@@ -118,6 +139,15 @@ private:
 	packet_analysis::TCP::TCPSessionAdapter* tcp_analyzer;
 
 	Type type;
+
+	// Reassemblers holding data, in the order they started doing so.
+	// They leave once they've delivered and trimmed all of it, so a
+	// later hole puts them at the end again.
+	static std::list<TCP_Reassembler*> buffering;
+	static bool enforcing_budget;
+
+	std::list<TCP_Reassembler*>::iterator buffering_pos;
+	bool is_buffering;
 };
 
 } // namespace tcp
@@ -17,6 +17,7 @@
 #include "zeek/Reporter.h"
 #include "zeek/IntrusivePtr.h"
 #include "zeek/logging/Manager.h"
+#include "zeek/logging/WriterFrontend.h"
 #include "zeek/DebugLogger.h"
 #include "zeek/iosource/Manager.h"
 #include "zeek/SerializationFormat.h"
@@ -151,6 +152,9 @@ public:
 
 const broker::endpoint_info Manager::NoPeer{{}, {}};
 
+// Version of the encoding of batched log records.
+static constexpr int LOG_BATCH_VERSION = 2;
+
 int Manager::script_scope = 0;
 
 struct scoped_reporter_location {
@@ -711,7 +715,8 @@ bool Manager::PublishLogCreate(EnumVal* stream, EnumVal* writer,
 	}
 
 bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
-                              int num_fields, const threading::Value* const * vals)
+                              int num_fields, const threading::Value* const * vals,
+                              const threading::Field* const * fields)
 	{
 	if ( bstate->endpoint.is_shutdown() )
 		return true;
@@ -738,33 +743,6 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 		return false;
 		}
 
-	zeek::detail::BinarySerializationFormat fmt;
-	char* data;
-	int len;
-
-	fmt.StartWrite();
-
-	bool success = fmt.Write(num_fields, "num_fields");
-
-	if ( ! success )
-		{
-		reporter->Error("Failed to remotely log stream %s: num_fields serialization failed", stream_id);
-		return false;
-		}
-
-	for ( int i = 0; i < num_fields; ++i )
-		{
-		if ( ! vals[i]->Write(&fmt) )
-			{
-			reporter->Error("Failed to remotely log stream %s: field %d serialization failed", stream_id, i);
-			return false;
-			}
-		}
-
-	len = fmt.EndWrite(&data);
-	std::string serial_data(data, len);
-	free(data);
-
 	auto v = log_topic_func->Invoke(IntrusivePtr{NewRef{}, stream},
 	                                make_intrusive<StringVal>(path));
 
@@ -778,20 +756,58 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path,
 
 	std::string topic = v->AsString()->CheckString();
 
-	auto bstream_id = broker::enum_value(move(stream_id));
-	auto bwriter_id = broker::enum_value(move(writer_id));
-	broker::zeek::LogWrite msg(move(bstream_id), move(bwriter_id), move(path),
-	                           move(serial_data));
-
-	DBG_LOG(DBG_BROKER, "Buffering log record: %s", RenderMessage(topic, msg.as_data()).c_str());
-
 	if ( log_buffers.size() <= (unsigned int)stream_id_num )
 		log_buffers.resize(stream_id_num + 1);
 
 	auto& lb = log_buffers[stream_id_num];
+	auto& wb = lb.msgs[topic][{writer->AsEnum(), path}];
+
+	if ( ! wb.num_records )
+		{
+		wb.stream_id = broker::enum_value(stream_id);
+		wb.writer_id = broker::enum_value(writer_id);
+		wb.path = path;
+
+		// The batch header, see ProcessLogWrite(). A zero field count
+		// distinguishes batches from single records; the number of
+		// records gets filled in by LogBuffer::Flush(). The field types
+		// let the receiver check that its writer has the same ones,
+		// since the values come without theirs.
+		wb.fmt.StartWrite();
+		wb.fmt.Write(0, "num_fields");
+		wb.fmt.Write(LOG_BATCH_VERSION, "batch_version");
+		wb.fmt.Write(num_fields, "batch_num_fields");
+		wb.fmt.Write(0, "batch_num_records");
+
+		for ( int i = 0; i < num_fields; ++i )
+			{
+			wb.fmt.Write(static_cast<int>(fields[i]->type), "batch_field_type");
+			wb.fmt.Write(static_cast<int>(fields[i]->subtype), "batch_field_subtype");
+			}
+		}
+
+	int record_start = wb.fmt.BytesWritten();
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		if ( ! vals[i]->WriteUntyped(&wb.fmt) )
+			{
+			reporter->Error("Failed to remotely log stream %s: field %d serialization failed, dropping record",
+			                stream_id, i);
+
+			// Cut off the partial record, keeping the ones buffered
+			// before it.
+			wb.fmt.RewindWrite(record_start);
+			++statistics.num_logs_dropped;
+			return false;
+			}
+		}
+
+	DBG_LOG(DBG_BROKER, "Buffering log record for stream %s at path %s",
+	        stream_id, path.c_str());
+
+	++wb.num_records;
 	++lb.message_count;
-	auto& pending_batch = lb.msgs[topic];
-	pending_batch.emplace_back(msg.move_data());
 
 	if ( lb.message_count >= log_batch_size )
 		statistics.num_logs_outgoing += lb.Flush(bstate->endpoint, log_batch_size);
@@ -808,13 +824,32 @@ size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_si
 		// No logs buffered for this stream.
 		return 0;
 
-	for ( auto& kv : msgs )
+	for ( auto& [topic, writer_batches] : msgs )
 		{
-		auto& topic = kv.first;
-		auto& pending_batch = kv.second;
 		broker::vector batch;
-		batch.reserve(log_batch_size + 1);
-		pending_batch.swap(batch);
+
+		for ( auto& [key, wb] : writer_batches )
+			{
+			if ( ! wb.num_records )
+				continue;
+
+			char* data;
+			auto len = wb.fmt.EndWrite(&data);
+
+			// Patch in the record count, the header's fourth word.
+			uint32_t num_records = htonl(wb.num_records);
+			memcpy(data + 3 * sizeof(uint32_t), &num_records, sizeof(num_records));
+
+			broker::zeek::LogWrite msg(wb.stream_id, wb.writer_id, wb.path,
+			                           std::string(data, len));
+			free(data);
+			wb.num_records = 0;
+			batch.emplace_back(msg.move_data());
+			}
+
+		if ( batch.empty() )
+			continue;
+
 		broker::zeek::Batch msg(std::move(batch));
 		endpoint.publish(topic, msg.move_data());
 		}
@@ -1467,7 +1502,6 @@ bool Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
-	++statistics.num_logs_incoming;
 	auto& stream_id_name = lw.stream_id().name;
 
 	// Get stream ID.
@@ -1516,6 +1550,17 @@ bool Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 		return false;
 		}
 
+	if ( num_fields == 0 )
+		{
+		// A batch of records, see PublishLogWrite().
+		bool result = ProcessLogWriteBatch(stream_id->AsEnumVal(), writer_id->AsEnumVal(),
+		                                   *path, &fmt);
+		fmt.EndRead();
+		return result;
+		}
+
+	++statistics.num_logs_incoming;
+
 	auto vals = new threading::Value* [num_fields];
 
 	for ( int i = 0; i < num_fields; ++i )
@@ -1540,6 +1585,94 @@ bool Manager::ProcessLogWrite(broker::zeek::LogWrite lw)
 	return true;
 	}
 
+bool Manager::ProcessLogWriteBatch(EnumVal* stream_id, EnumVal* writer_id,
+                                   const std::string& path,
+                                   zeek::detail::BinarySerializationFormat* fmt)
+	{
+	const char* stream_name = stream_id->GetType()->AsEnumType()->Lookup(stream_id->AsEnum());
+	int version, num_fields, num_records;
+
+	if ( ! (fmt->Read(&version, "batch_version") &&
+	        fmt->Read(&num_fields, "batch_num_fields") &&
+	        fmt->Read(&num_records, "batch_num_records")) )
+		{
+		reporter->Warning("failed to unserialize remote log batch header for stream: %s", stream_name);
+		return false;
+		}
+
+	if ( version != LOG_BATCH_VERSION )
+		{
+		reporter->Warning("unsupported remote log batch version %d for stream: %s", version, stream_name);
+		return false;
+		}
+
+	statistics.num_logs_incoming += num_records;
+
+	auto writer = log_mgr->FindWriterForRemoteLog(stream_id, writer_id, path);
+
+	if ( ! writer )
+		// Unknown writer or disabled stream, like for WriteFromRemote().
+		return false;
+
+	if ( writer->NumFields() != num_fields )
+		{
+		reporter->Warning("remote log batch for stream %s has %d fields, expected %d",
+		                  stream_name, num_fields, writer->NumFields());
+		return false;
+		}
+
+	// The values come without types, so they get decoded as those of
+	// the writer's fields, which need to match the sender's.
+	auto fields = writer->Fields();
+
+	for ( int i = 0; i < num_fields; ++i )
+		{
+		int type, subtype;
+
+		if ( ! (fmt->Read(&type, "batch_field_type") &&
+		        fmt->Read(&subtype, "batch_field_subtype")) )
+			{
+			reporter->Warning("failed to unserialize remote log batch header for stream: %s", stream_name);
+			return false;
+			}
+
+		if ( type != fields[i]->type || subtype != fields[i]->subtype )
+			{
+			reporter->Warning("remote log batch for stream %s has type %s for field %s, expected %s",
+			                  stream_name, type_name(static_cast<TypeTag>(type)), fields[i]->name,
+			                  type_name(fields[i]->type));
+			return false;
+			}
+		}
+
+	for ( int r = 0; r < num_records; ++r )
+		{
+		auto vals = new threading::Value* [num_fields];
+
+		for ( int i = 0; i < num_fields; ++i )
+			{
+			vals[i] = new threading::Value;
+
+			if ( ! vals[i]->ReadUntyped(fmt, fields[i]->type, fields[i]->subtype) )
+				{
+				for ( int j = 0; j <= i; ++j )
+					delete vals[j];
+
+				delete [] vals;
+				reporter->Warning("failed to unserialize remote log field %d for stream: %s", i, stream_name);
+				return false;
+				}
+			}
+
+		writer->Write(num_fields, vals);
+		}
+
+	DBG_LOG(DBG_BROKER, "Wrote batch of %d remote log records to path '%s' on stream '%s'",
+	        num_records, path.c_str(), stream_name);
+
+	return true;
+	}
+
 bool Manager::ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu)
 	{
 	DBG_LOG(DBG_BROKER, "Received id-update: %s", RenderMessage(iu.as_data()).c_str());
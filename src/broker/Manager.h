@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -19,6 +20,7 @@
 #include <broker/zeek.hh>
 
 #include "zeek/IntrusivePtr.h"
+#include "zeek/SerializationFormat.h"
 #include "zeek/iosource/IOSource.h"
 #include "zeek/logging/WriterBackend.h"
 
@@ -61,6 +63,8 @@ struct Stats {
 	size_t num_logs_incoming = 0;
 	// Number of total log records sent.
 	size_t num_logs_outgoing = 0;
+	// Number of log records that couldn't be serialized for sending.
+	size_t num_logs_dropped = 0;
 	// Number of total identifiers received.
 	size_t num_ids_incoming = 0;
 	// Number of total identifiers sent.
@@ -202,12 +206,15 @@ public:
 	 * @param path the log path to output the log entry to.
 	 * @param num_vals the number of fields to log.
 	 * @param vals the log values to log, of size num_vals.
+	 * @param fields the writer's fields, of size num_vals. Their types
+	 * go along with the values so that receivers can check them.
 	 * See the Broker::SendFlags record type.
 	 * @return true if the message is sent successfully.
 	 */
 	bool PublishLogWrite(EnumVal* stream, EnumVal* writer,
 	                     std::string path, int num_vals,
-	                     const threading::Value* const * vals);
+	                     const threading::Value* const * vals,
+	                     const threading::Field* const * fields);
 
 	/**
 	 * Automatically send an event to any interested peers whenever it is
@@ -403,6 +410,9 @@ private:
 	void ProcessEvent(const broker::topic& topic, broker::zeek::Event ev);
 	bool ProcessLogCreate(broker::zeek::LogCreate lc);
 	bool ProcessLogWrite(broker::zeek::LogWrite lw);
+	bool ProcessLogWriteBatch(EnumVal* stream_id, EnumVal* writer_id,
+	                          const std::string& path,
+	                          zeek::detail::BinarySerializationFormat* fmt);
 	bool ProcessIdentifierUpdate(broker::zeek::IdentifierUpdate iu);
 	void ProcessStatus(broker::status_view stat);
 	void ProcessError(broker::error_view err);
@@ -424,9 +434,21 @@ private:
 	const char* Tag() override	{ return "Broker::Manager"; }
 	double GetNextTimeout() override	{ return -1; }
 
+	// Log records of a single writer that are waiting to be sent, all
+	// serialized into one buffer. Values are written without their
+	// types, which the receiver knows from the writer's fields.
+	struct LogWriteBatch {
+		broker::enum_value stream_id;
+		broker::enum_value writer_id;
+		std::string path;
+		zeek::detail::BinarySerializationFormat fmt;
+		size_t num_records = 0;
+	};
+
 	struct LogBuffer {
-		// Indexed by topic string.
-		std::unordered_map<std::string, broker::vector> msgs;
+		// Indexed by topic string, then by writer and path.
+		std::unordered_map<std::string,
+		                   std::map<std::pair<bro_int_t, std::string>, LogWriteBatch>> msgs;
 		size_t message_count;
 
 		size_t Flush(broker::endpoint& endpoint, size_t batch_size);
@@ -2,6 +2,8 @@
 
 #include "zeek/file_analysis/File.h"
 
+#include <algorithm>
+#include <cstring>
 #include <utility>
 
 #include "zeek/file_analysis/FileReassembler.h"
@@ -113,6 +115,61 @@ File::~File()
 		delete a;
 	}
 
+File::BOF_Buffer::BOF_Buffer()
+	: full(false), size(0), capacity(0), data(nullptr)
+	{
+	}
+
+File::BOF_Buffer::~BOF_Buffer()
+	{
+	delete [] data;
+	}
+
+void File::BOF_Buffer::Append(const u_char* arg_data, uint64_t len, uint64_t size_hint)
+	{
+	if ( sealed )
+		return;
+
+	// Reserve room for a trailing NUL so that sealing can hand the
+	// allocation over to a String as-is.
+	if ( size + len + 1 > capacity )
+		{
+		// Grow geometrically from the data we actually have, as most
+		// files are much smaller than the BOF buffer. Beyond the hint,
+		// allocate only what the last chunk needs.
+		uint64_t new_capacity = std::max(size + len, std::min(capacity * 2, size_hint)) + 1;
+		auto* new_data = new u_char[new_capacity];
+
+		if ( size > 0 )
+			memcpy(new_data, data, size);
+
+		delete [] data;
+		data = new_data;
+		capacity = new_capacity;
+		}
+
+	memcpy(data + size, arg_data, len);
+	size += len;
+	chunk_ends.push_back(size);
+	}
+
+const StringValPtr& File::BOF_Buffer::Seal()
+	{
+	if ( sealed || ! data )
+		return sealed;
+
+	data[size] = '\0';
+	sealed = make_intrusive<StringVal>(new String(true, data, size));
+	data = nullptr;
+	capacity = 0;
+	return sealed;
+	}
+
+const u_char* File::BOF_Buffer::Bytes() const
+	{
+	return sealed ? sealed->Bytes() : data;
+	}
+
 void File::UpdateLastActivityTime()
 	{
 	val->AssignTime(last_active_idx, run_state::network_time);
@@ -298,7 +355,7 @@ bool File::SetMime(const std::string& mime_type)
 		return false;
 
 	auto meta = make_intrusive<RecordVal>(id::fa_metadata);
-	meta->Assign(meta_mime_type_idx, mime_type);
+	meta->Assign(meta_mime_type_idx, val_mgr->InternedString(INTERN_MIME_TYPE, mime_type));
 	meta->Assign(meta_inferred_idx, false);
 
 	FileEvent(file_sniff, {val, std::move(meta)});
@@ -316,9 +373,8 @@ void File::InferMetadata()
 		if ( bof_buffer.size == 0 )
 			return;
 
-		String* bs = concatenate(bof_buffer.chunks);
-		val->Assign(bof_buffer_idx, bs);
-		bof_buffer_val = val->GetField(bof_buffer_idx);
+		bof_buffer_val = bof_buffer.Seal();
+		val->Assign(bof_buffer_idx, bof_buffer_val);
 		}
 
 	if ( ! FileEventAvailable(file_sniff) )
@@ -335,7 +391,8 @@ void File::InferMetadata()
 	if ( ! matches.empty() )
 		{
 		meta->Assign(meta_mime_type_idx,
-		                        *(matches.begin()->second.begin()));
+		             val_mgr->InternedString(INTERN_MIME_TYPE,
+		                                     *(matches.begin()->second.begin())));
 		meta->Assign(meta_mime_types_idx,
 		             file_analysis::GenMIMEMatchesVal(matches));
 		}
@@ -350,8 +407,7 @@ bool File::BufferBOF(const u_char* data, uint64_t len)
 
 	uint64_t desired_size = LookupFieldDefaultCount(bof_buffer_size_idx);
 
-	bof_buffer.chunks.push_back(new String(data, len, false));
-	bof_buffer.size += len;
+	bof_buffer.Append(data, len, desired_size);
 
 	if ( bof_buffer.size < desired_size )
 		return true;
@@ -359,10 +415,7 @@ bool File::BufferBOF(const u_char* data, uint64_t len)
 	bof_buffer.full = true;
 
 	if ( bof_buffer.size > 0 )
-		{
-		String* bs = concatenate(bof_buffer.chunks);
-		val->Assign(bof_buffer_idx, bs);
-		}
+		val->Assign(bof_buffer_idx, bof_buffer.Seal());
 
 	return false;
 	}
@@ -392,29 +445,27 @@ void File::DeliverStream(const u_char* data, uint64_t len)
 		if ( ! a->GotStreamDelivery() )
 			{
 			DBG_LOG(DBG_FILE_ANALYSIS, "skipping stream delivery to analyzer %s", file_mgr->GetComponentName(a->Tag()).c_str());
-			int num_bof_chunks_behind = bof_buffer.chunks.size();
+			int num_bof_chunks_behind = bof_buffer.NumChunks();
 
 			if ( ! bof_was_full )
 				// We just added a chunk to the BOF buffer, don't count it
 				// as it will get delivered on its own.
 				num_bof_chunks_behind -= 1;
 
-			uint64_t bytes_delivered = 0;
+			const u_char* bof_data = bof_buffer.Bytes();
 
 			// Catch this analyzer up with the BOF buffer.
 			for ( int i = 0; i < num_bof_chunks_behind; ++i )
 				{
-				if ( ! a->Skipping() )
+				if ( a->Skipping() )
+					break;
+
+				if ( ! a->DeliverStream(bof_data + bof_buffer.ChunkStart(i),
+				                        bof_buffer.ChunkLen(i)) )
 					{
-					if ( ! a->DeliverStream(bof_buffer.chunks[i]->Bytes(),
-								bof_buffer.chunks[i]->Len()) )
-						{
-						a->SetSkip(true);
-						analyzers.QueueRemove(a->Tag(), a->GetArgs());
-						}
+					a->SetSkip(true);
+					analyzers.QueueRemove(a->Tag(), a->GetArgs());
 					}
-
-				bytes_delivered += bof_buffer.chunks[i]->Len();
 				}
 
 			a->SetGotStreamDelivery();
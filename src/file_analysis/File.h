@@ -5,6 +5,7 @@
 #include <list>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "zeek/analyzer/Tag.h"
 #include "zeek/file_analysis/AnalyzerSet.h"
@@ -19,7 +20,9 @@ class Connection;
 class EventHandlerPtr;
 class RecordVal;
 class RecordType;
+class StringVal;
 using RecordValPtr = IntrusivePtr<RecordVal>;
+using StringValPtr = IntrusivePtr<StringVal>;
 using RecordTypePtr = IntrusivePtr<RecordType>;
 
 namespace file_analysis {
@@ -333,14 +336,63 @@ protected:
 	detail::AnalyzerSet analyzers;     /**< A set of attached file analyzers. */
 	std::list<Analyzer *> done_analyzers; /**< Analyzers we're done with, remembered here until they can be safely deleted. */
 
+	/**
+	 * Beginning-of-file buffer.  Incoming data is appended into a single
+	 * contiguous allocation that is handed over to a reference-counted
+	 * StringVal once the buffer is sealed, so the same bytes back both the
+	 * \c bof_buffer field of #val and catch-up deliveries to late analyzers
+	 * without further copies.
+	 */
 	struct BOF_Buffer {
-		BOF_Buffer() : full(false), size(0) {}
-		~BOF_Buffer()
-			{ for ( size_t i = 0; i < chunks.size(); ++i ) delete chunks[i]; }
+		BOF_Buffer();
+		~BOF_Buffer();
+
+		/**
+		 * Appends a chunk of data to the buffer.
+		 * @param data pointer to a data chunk to buffer.
+		 * @param len number of bytes in the data chunk.
+		 * @param size_hint the desired size of the buffer, which caps
+		 *        how far the allocation grows ahead of the data.
+		 */
+		void Append(const u_char* data, uint64_t len, uint64_t size_hint);
+
+		/**
+		 * Transfers the buffered data into a StringVal (without copying
+		 * it) after which no further data can be appended.
+		 * @return the sealed buffer contents or null if nothing had been
+		 *         buffered.
+		 */
+		const StringValPtr& Seal();
+
+		/**
+		 * @return the start of the buffered data.
+		 */
+		const u_char* Bytes() const;
+
+		/**
+		 * @return the number of chunks appended to the buffer.
+		 */
+		size_t NumChunks() const
+			{ return chunk_ends.size(); }
+
+		/**
+		 * @return the offset within the buffer at which chunk \a i starts.
+		 */
+		uint64_t ChunkStart(size_t i) const
+			{ return i == 0 ? 0 : chunk_ends[i - 1]; }
+
+		/**
+		 * @return the length of chunk \a i.
+		 */
+		uint64_t ChunkLen(size_t i) const
+			{ return chunk_ends[i] - ChunkStart(i); }
 
 		bool full;
 		uint64_t size;
-		String::CVec chunks;
+		uint64_t capacity;
+		u_char* data;                   /**< Pending bytes until sealed. */
+		StringValPtr sealed;            /**< Owns the bytes once sealed. */
+		std::vector<uint64_t> chunk_ends; /**< End offset of each chunk. */
 	} bof_buffer;              /**< Beginning of file buffer. */
 
 	zeek::detail::WeirdStateMap weird_state;
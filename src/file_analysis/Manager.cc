@@ -547,7 +547,7 @@ VectorValPtr GenMIMEMatchesVal(const zeek::detail::RuleMatcher::MIME_Matches& m)
 		      it2 != it->second.end(); ++it2 )
 			{
 			element->Assign(0, it->first);
-			element->Assign(1, *it2);
+			element->Assign(1, val_mgr->InternedString(INTERN_MIME_TYPE, *it2));
 			}
 
 		rval->Assign(rval->Size(), std::move(element));
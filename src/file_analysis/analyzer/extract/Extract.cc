@@ -9,15 +9,32 @@
 #include "zeek/Event.h"
 #include "zeek/file_analysis/Manager.h"
 
+#include "zeek/file_analysis/analyzer/extract/consts.bif.h"
+
 namespace zeek::file_analysis::detail {
 
 Extract::Extract(RecordValPtr args, file_analysis::File* file,
                  const std::string& arg_filename, uint64_t arg_limit)
     : file_analysis::Analyzer(file_mgr->GetComponentTag("EXTRACT"),
                               std::move(args), file),
-      filename(arg_filename), limit(arg_limit), depth(0)
+      filename(arg_filename), file_stream(nullptr), staged_offset(0),
+      limit(arg_limit), depth(0)
 	{
 	char buf[128];
+
+	if ( BifConst::FileExtract::async_writes )
+		{
+		async_file = ExtractWriter::Get()->Open(filename);
+
+		if ( ! async_file )
+			{
+			util::zeek_strerror_r(errno, buf, sizeof(buf));
+			reporter->Error("cannot open %s: %s", filename.c_str(), buf);
+			}
+
+		return;
+		}
+
 	file_stream = fopen(filename.data(), "w");
 
 	if ( file_stream )
@@ -39,6 +56,12 @@ Extract::Extract(RecordValPtr args, file_analysis::File* file,
 
 Extract::~Extract()
 	{
+	if ( async_file )
+		{
+		FlushStaged();
+		ExtractWriter::Get()->Close(async_file, depth);
+		}
+
 	if ( file_stream && fclose(file_stream) )
 		{
 		char buf[128];
@@ -97,9 +120,64 @@ static bool check_limit_exceeded(uint64_t lim, uint64_t depth, uint64_t len, uin
 	return false;
 	}
 
+// Amount of data collected before handing it to the ExtractWriter thread.
+static constexpr uint64_t ASYNC_BATCH_SIZE = 64 * 1024;
+
+bool Extract::Write(const u_char* data, uint64_t len)
+	{
+	if ( async_file )
+		{
+		// The writer thread has already reported the error.
+		if ( async_file->failed )
+			return false;
+
+		if ( staged.empty() )
+			staged_offset = depth;
+
+		staged.insert(staged.end(), data, data + len);
+		depth += len;
+
+		if ( staged.size() >= ASYNC_BATCH_SIZE )
+			FlushStaged();
+
+		return true;
+		}
+
+	if ( fwrite(data, len, 1, file_stream) != 1 )
+		{
+		char buf[128];
+		util::zeek_strerror_r(errno, buf, sizeof(buf));
+		reporter->Error("failed to write to extracted file %s: %s",
+		                filename.data(), buf);
+		fclose(file_stream);
+		file_stream = nullptr;
+		return false;
+		}
+
+	depth += len;
+	return true;
+	}
+
+void Extract::FlushStaged()
+	{
+	if ( staged.empty() )
+		return;
+
+	uint64_t len = staged.size();
+	std::vector<u_char> data;
+	data.swap(staged);
+
+	if ( ! ExtractWriter::Get()->Write(async_file, staged_offset, std::move(data)) &&
+	     ! async_file->failed )
+		// The writer's queue for this file is full.  The data is lost,
+		// leaving a zero-filled hole in the extracted file.
+		reporter->Weird(GetFile(), "file_extraction_dropped_data",
+		                util::fmt("%" PRIu64, len));
+	}
+
 bool Extract::DeliverStream(const u_char* data, uint64_t len)
 	{
-	if ( ! file_stream )
+	if ( ! file_stream && ! async_file )
 		return false;
 
 	uint64_t towrite = 0;
@@ -119,29 +197,19 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len)
 		limit_exceeded = check_limit_exceeded(limit, depth, len, &towrite);
 		}
 
-	char buf[128];
-
-	if ( towrite > 0 )
-		{
-		if ( fwrite(data, towrite, 1, file_stream) != 1 )
-			{
-			util::zeek_strerror_r(errno, buf, sizeof(buf));
-			reporter->Error("failed to write to extracted file %s: %s",
-			                filename.data(), buf);
-			fclose(file_stream);
-			file_stream = nullptr;
-			return false;
-			}
+	if ( towrite > 0 && ! Write(data, towrite) )
+		return false;
 
-		depth += towrite;
-		}
+	if ( limit_exceeded && async_file )
+		FlushStaged();
 
 	// Assume we may not try to write anything more for a while due to reaching
 	// the extraction limit and the file analysis File still proceeding to
 	// do other analysis without destructing/closing this one until the very end,
 	// so flush anything currently buffered.
-	if ( limit_exceeded && fflush(file_stream) )
+	if ( limit_exceeded && file_stream && fflush(file_stream) )
 		{
+		char buf[128];
 		util::zeek_strerror_r(errno, buf, sizeof(buf));
 		reporter->Warning("cannot fflush extracted file %s: %s",
 		                  filename.data(), buf);
@@ -152,10 +220,16 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len)
 
 bool Extract::Undelivered(uint64_t offset, uint64_t len)
 	{
-	if ( ! file_stream )
+	if ( ! file_stream && ! async_file )
 		return false;
 
-	if ( depth == offset )
+	if ( depth == offset && async_file )
+		{
+		// Writes are positional, so just skip ahead and leave a hole.
+		FlushStaged();
+		depth += len;
+		}
+	else if ( depth == offset )
 		{
 		char* tmp = new char[len]();
 
@@ -8,6 +8,7 @@
 #include "zeek/Val.h"
 #include "zeek/file_analysis/File.h"
 #include "zeek/file_analysis/Analyzer.h"
+#include "zeek/file_analysis/analyzer/extract/ExtractWriter.h"
 
 #include "zeek/file_analysis/analyzer/extract/events.bif.h"
 
@@ -72,8 +73,23 @@ protected:
 	        const std::string& arg_filename, uint64_t arg_limit);
 
 private:
+	/**
+	 * Writes data at the current depth, either directly or through the
+	 * ExtractWriter thread.
+	 * @return false if writing failed and extraction must stop.
+	 */
+	bool Write(const u_char* data, uint64_t len);
+
+	/**
+	 * Hands data staged for the ExtractWriter thread over to it.
+	 */
+	void FlushStaged();
+
 	std::string filename;
 	FILE* file_stream;
+	ExtractWriter::FilePtr async_file; /**< Set if writes go through ExtractWriter. */
+	std::vector<u_char> staged;        /**< Data not yet handed to the writer. */
+	uint64_t staged_offset;            /**< File offset of #staged. */
 	uint64_t limit;
 	uint64_t depth;
 };
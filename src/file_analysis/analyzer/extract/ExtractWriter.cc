@@ -0,0 +1,237 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/file_analysis/analyzer/extract/ExtractWriter.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "zeek/Reporter.h"
+#include "zeek/util.h"
+
+#include "zeek/file_analysis/analyzer/extract/consts.bif.h"
+
+namespace zeek::file_analysis::detail {
+
+class ExtractWriteMessage final : public threading::InputMessage<ExtractWriter>
+{
+public:
+	ExtractWriteMessage(ExtractWriter* writer, ExtractWriter::FilePtr arg_file,
+	                    uint64_t arg_offset, std::vector<u_char> arg_data)
+		: threading::InputMessage<ExtractWriter>("ExtractWrite", writer),
+		file(std::move(arg_file)), offset(arg_offset), data(std::move(arg_data))
+		{ }
+
+	bool Process() override
+		{
+		Object()->DoWrite(file.get(), offset, data);
+		return true;
+		}
+
+private:
+	ExtractWriter::FilePtr file;
+	uint64_t offset;
+	std::vector<u_char> data;
+};
+
+class ExtractCloseMessage final : public threading::InputMessage<ExtractWriter>
+{
+public:
+	ExtractCloseMessage(ExtractWriter* writer, ExtractWriter::FilePtr arg_file,
+	                    uint64_t arg_size)
+		: threading::InputMessage<ExtractWriter>("ExtractClose", writer),
+		file(std::move(arg_file)), size(arg_size)
+		{ }
+
+	bool Process() override
+		{
+		Object()->DoClose(file.get(), size);
+		return true;
+		}
+
+private:
+	ExtractWriter::FilePtr file;
+	uint64_t size;
+};
+
+ExtractWriter* ExtractWriter::instance = nullptr;
+
+ExtractWriter::ExtractWriter()
+	{
+	max_queued = BifConst::FileExtract::async_buffer_size;
+	block_when_full = BifConst::FileExtract::async_block_when_full;
+	SetName("file-extract-writer");
+	}
+
+ExtractWriter::~ExtractWriter()
+	{
+	if ( instance == this )
+		instance = nullptr;
+	}
+
+ExtractWriter* ExtractWriter::Get()
+	{
+	if ( ! instance )
+		{
+		instance = new ExtractWriter();
+		instance->Start();
+		}
+
+	return instance;
+	}
+
+ExtractWriter::Stats ExtractWriter::GetStats()
+	{
+	Stats s = {};
+
+	if ( ! instance )
+		return s;
+
+	s.queued_bytes = instance->queued_bytes;
+	s.written_bytes = instance->written_bytes;
+	s.dropped_bytes = instance->dropped_bytes;
+	s.writes = instance->writes;
+	s.write_errors = instance->write_errors;
+	s.write_time = instance->write_nsecs / 1e9;
+	s.max_write_time = instance->max_write_nsecs / 1e9;
+	return s;
+	}
+
+ExtractWriter::FilePtr ExtractWriter::Open(const std::string& filename)
+	{
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+
+	if ( fd < 0 )
+		return nullptr;
+
+	return std::make_shared<File>(filename, fd);
+	}
+
+bool ExtractWriter::Write(const FilePtr& f, uint64_t offset, std::vector<u_char> data)
+	{
+	uint64_t len = data.size();
+
+	if ( f->failed )
+		return false;
+
+	if ( max_queued > 0 && f->queued_bytes + len > max_queued )
+		{
+		if ( ! block_when_full )
+			{
+			dropped_bytes += len;
+			return false;
+			}
+
+		// Besides DoWrite(), the thread stopping wakes us up. The timeout
+		// covers it dying in a way that doesn't, so that we never wait
+		// for a queue that no one drains anymore.
+		auto done = [&]
+			{
+			// A single write larger than the limit gets through once
+			// the queue has drained completely.
+			return f->queued_bytes == 0 || f->queued_bytes + len <= max_queued ||
+			       f->failed || Terminating() || Failed();
+			};
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while ( ! written.wait_for(lock, std::chrono::milliseconds(100), done) )
+			;
+
+		if ( f->failed || Terminating() || Failed() )
+			return false;
+		}
+
+	f->queued_bytes += len;
+	queued_bytes += len;
+	SendIn(new ExtractWriteMessage(this, f, offset, std::move(data)));
+	return true;
+	}
+
+bool ExtractWriter::OnFinish(double network_time)
+	{
+	WakeUp();
+	return true;
+	}
+
+void ExtractWriter::OnKill()
+	{
+	MsgThread::OnKill();
+	WakeUp();
+	}
+
+void ExtractWriter::WakeUp()
+	{
+	std::lock_guard<std::mutex> lock(mutex);
+	written.notify_all();
+	}
+
+void ExtractWriter::Close(const FilePtr& f, uint64_t size)
+	{
+	SendIn(new ExtractCloseMessage(this, f, size));
+	}
+
+void ExtractWriter::DoWrite(File* f, uint64_t offset, const std::vector<u_char>& data)
+	{
+	uint64_t len = data.size();
+
+	if ( ! f->failed )
+		{
+		auto start = std::chrono::steady_clock::now();
+		const u_char* p = data.data();
+		uint64_t remaining = len;
+
+		while ( remaining > 0 )
+			{
+			ssize_t n = pwrite(f->fd, p, remaining, offset);
+
+			if ( n < 0 )
+				{
+				if ( errno == EINTR )
+					continue;
+
+				Error(Fmt("failed to write to extracted file %s: %s",
+				          f->filename.c_str(), Strerror(errno)));
+				++write_errors;
+				f->failed = true;
+				break;
+				}
+
+			++writes;
+			p += n;
+			offset += n;
+			remaining -= n;
+			}
+
+		auto nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+
+		write_nsecs += nsecs;
+
+		if ( static_cast<uint64_t>(nsecs) > max_write_nsecs )
+			max_write_nsecs = nsecs;
+
+		written_bytes += len - remaining;
+		}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	f->queued_bytes -= len;
+	queued_bytes -= len;
+	written.notify_all();
+	}
+
+void ExtractWriter::DoClose(File* f, uint64_t size)
+	{
+	// Trailing gaps were never written, so extend the file to its full
+	// size.  This leaves them zero-filled, just like synchronous writes.
+	if ( ! f->failed && ftruncate(f->fd, size) < 0 )
+		Warning(Fmt("cannot extend extracted file %s: %s",
+		            f->filename.c_str(), Strerror(errno)));
+
+	if ( close(f->fd) < 0 )
+		Error(Fmt("cannot close %s: %s", f->filename.c_str(), Strerror(errno)));
+
+	f->fd = -1;
+	}
+
+} // namespace zeek::file_analysis::detail
@@ -0,0 +1,138 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "zeek/threading/MsgThread.h"
+
+namespace zeek::file_analysis::detail {
+
+/**
+ * A thread performing the disk writes of the file extraction analyzer, so
+ * that slow or busy storage doesn't stall packet processing.  Data is
+ * queued per extracted file, bounded by FileExtract::async_buffer_size.
+ * Once a file's queue is full, further data is either dropped or the
+ * main thread blocks until the writer has caught up, depending on
+ * FileExtract::async_block_when_full.
+ */
+class ExtractWriter final : public threading::MsgThread {
+public:
+	/**
+	 * State of a single extracted file, shared between the main thread
+	 * and the writer thread.
+	 */
+	struct File {
+		File(std::string arg_filename, int arg_fd)
+			: filename(std::move(arg_filename)), fd(arg_fd)
+			{ }
+
+		std::string filename;
+		int fd;
+		std::atomic<uint64_t> queued_bytes{0};
+		std::atomic<bool> failed{false};
+	};
+
+	using FilePtr = std::shared_ptr<File>;
+
+	/**
+	 * Counters describing the writer's activity since startup.
+	 */
+	struct Stats {
+		uint64_t queued_bytes;   /**< Bytes currently waiting to be written. */
+		uint64_t written_bytes;  /**< Bytes written to disk. */
+		uint64_t dropped_bytes;  /**< Bytes dropped because a queue was full. */
+		uint64_t writes;         /**< Number of write system calls. */
+		uint64_t write_errors;   /**< Number of failed writes. */
+		double write_time;       /**< Total time spent in writes, in seconds. */
+		double max_write_time;   /**< Longest single write, in seconds. */
+	};
+
+	/**
+	 * Returns the writer instance, creating and starting the thread on
+	 * first use.  Must only be called from the main thread.
+	 */
+	static ExtractWriter* Get();
+
+	/**
+	 * Returns the writer's counters, or all zeroes if no writer has been
+	 * started.
+	 */
+	static Stats GetStats();
+
+	/**
+	 * Opens a file for extraction.  Called from the main thread so that
+	 * errors are reported synchronously.
+	 * @param filename the path of the file to create.
+	 * @return the file's state, or null if it couldn't be opened, in which
+	 *         case errno is set.
+	 */
+	FilePtr Open(const std::string& filename);
+
+	/**
+	 * Queues data for writing at a given offset.
+	 * @param f the file to write to.
+	 * @param offset the offset in the file at which to write the data.
+	 * @param data the data to write.
+	 * @return false if the data was dropped because the file's queue was
+	 *         full or a previous write has failed, else true.
+	 */
+	bool Write(const FilePtr& f, uint64_t offset, std::vector<u_char> data);
+
+	/**
+	 * Queues closing a file once all its pending writes are done.
+	 * @param f the file to close.
+	 * @param size the final size of the file, which may extend past the
+	 *        last written byte if the file ended in a gap.
+	 */
+	void Close(const FilePtr& f, uint64_t size);
+
+	/**
+	 * Writes data to a file.  Executed by the writer thread.
+	 */
+	void DoWrite(File* f, uint64_t offset, const std::vector<u_char>& data);
+
+	/**
+	 * Closes a file.  Executed by the writer thread.
+	 */
+	void DoClose(File* f, uint64_t size);
+
+protected:
+	~ExtractWriter() override;
+
+	bool OnHeartbeat(double network_time, double current_time) override
+		{ return true; }
+	bool OnFinish(double network_time) override;
+	void OnKill() override;
+
+private:
+	ExtractWriter();
+
+	// Wakes up a Write() waiting for its queue to shrink.
+	void WakeUp();
+
+	std::mutex mutex;
+	std::condition_variable written; // Signaled whenever a queue shrinks.
+
+	uint64_t max_queued;
+	bool block_when_full;
+
+	std::atomic<uint64_t> queued_bytes{0};
+	std::atomic<uint64_t> written_bytes{0};
+	std::atomic<uint64_t> dropped_bytes{0};
+	std::atomic<uint64_t> writes{0};
+	std::atomic<uint64_t> write_errors{0};
+	std::atomic<uint64_t> write_nsecs{0};
+	std::atomic<uint64_t> max_write_nsecs{0};
+
+	static ExtractWriter* instance;
+};
+
+} // namespace zeek::file_analysis::detail
@@ -3,10 +3,15 @@
 #include "zeek/iosource/Manager.h"
 
 #include <sys/types.h>
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#else
 #include <sys/event.h>
+#endif
 #include <sys/time.h>
 #include <unistd.h>
 #include <assert.h>
+#include <cmath>
 
 #include "zeek/iosource/Component.h"
 #include "zeek/iosource/IOSource.h"
@@ -46,9 +51,18 @@ void Manager::WakeupHandler::Ping(const std::string& where)
 
 Manager::Manager()
 	{
+#ifdef HAVE_EPOLL
+	event_queue = epoll_create1(EPOLL_CLOEXEC);
+	if ( event_queue == -1 )
+		reporter->FatalError("Failed to initialize epoll: %s", strerror(errno));
+
+	// epoll_wait() insists on room for at least one event.
+	events.resize(1);
+#else
 	event_queue = kqueue();
 	if ( event_queue == -1 )
 		reporter->FatalError("Failed to initialize kqueue: %s", strerror(errno));
+#endif
 	}
 
 Manager::~Manager()
@@ -71,7 +85,9 @@ Manager::~Manager()
 
 	for ( PktDumperList::iterator i = pkt_dumpers.begin(); i != pkt_dumpers.end(); ++i )
 		{
-		(*i)->Done();
+		if ( (*i)->IsOpen() )
+			(*i)->Done();
+
 		delete *i;
 		}
 
@@ -84,6 +100,7 @@ Manager::~Manager()
 void Manager::InitPostScript()
 	{
 	wakeup = new WakeupHandler();
+	busy_poll_duration = BifConst::live_busy_poll_duration;
 	}
 
 void Manager::RemoveAll()
@@ -158,7 +175,7 @@ void Manager::FindReadySources(std::vector<IOSource*>* ready)
 				{
 				if ( pkt_src->IsLive() )
 					{
-					if ( ! time_to_poll )
+					if ( ! time_to_poll && PollPktSrcNow() )
 						// Avoid calling Poll() if we can help it since on very
 						// high-traffic networks, we spend too much time in
 						// Poll() and end up dropping packets.
@@ -184,8 +201,142 @@ void Manager::FindReadySources(std::vector<IOSource*>* ready)
 		Poll(ready, timeout, timeout_src);
 	}
 
+bool Manager::PollPktSrcNow()
+	{
+	// Without a file descriptor, asking the source is all we can do.
+	if ( ! pkt_src->IsSelectable() )
+		return true;
+
+	double idle_since = pkt_src->IdleSince();
+
+	if ( idle_since == 0.0 )
+		return true;
+
+	if ( busy_poll_duration > 0.0 &&
+	     util::current_time(true) - idle_since < busy_poll_duration )
+		{
+		++stats.busy_polls;
+		return true;
+		}
+
+	return false;
+	}
+
+Manager::Stats Manager::GetStats() const
+	{
+	Stats s = stats;
+
+	if ( pkt_src )
+		{
+		s.wakeups = pkt_src->NumWakeups();
+		s.wakeup_latency = pkt_src->WakeupLatency();
+		}
+
+	return s;
+	}
+
+#ifdef HAVE_EPOLL
+
 void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* timeout_src)
 	{
+	++stats.polls;
+
+	int ret = epoll_wait(event_queue, events.data(), events.size(), ConvertTimeout(timeout));
+	if ( ret == -1 )
+		{
+		// Ignore interrupts since we may catch one during shutdown and we don't want the
+		// error to get printed.
+		if ( errno != EINTR )
+			reporter->InternalWarning("Error calling epoll_wait: %s", strerror(errno));
+		}
+	else if ( ret == 0 )
+		{
+		++stats.poll_timeouts;
+
+		if ( timeout_src )
+			ready->push_back(timeout_src);
+		}
+	else
+		{
+		for ( int i = 0; i < ret; i++ )
+			{
+			auto it = fd_map.find(events[i].data.fd);
+			if ( it != fd_map.end() )
+				ready->push_back(it->second);
+			}
+		}
+	}
+
+int Manager::ConvertTimeout(double timeout)
+	{
+	// If timeout ended up -1, set it to some nominal value just to keep the loop
+	// from blocking forever. This is the case of exit_only_after_terminate when
+	// there isn't anything else going on.
+	if ( timeout < 0 )
+		return 100;
+
+	// epoll_wait() only takes milliseconds. Round up, as rounding down would
+	// spin until a timer that's less than a millisecond away expires. Packet
+	// sources without a file descriptor ask for such short timeouts, but get
+	// checked on every loop iteration anyway, see PollPktSrcNow().
+	return static_cast<int>(std::ceil(timeout * 1000));
+	}
+
+bool Manager::RegisterFd(int fd, IOSource* src)
+	{
+	// Level-triggered: sources aren't required to drain their file
+	// descriptor in a single Process() call.
+	struct epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+
+	int ret = epoll_ctl(event_queue, EPOLL_CTL_ADD, fd, &event);
+	if ( ret != -1 )
+		{
+		DBG_LOG(DBG_MAINLOOP, "Registered fd %d from %s", fd, src->Tag());
+		fd_map[fd] = src;
+
+		if ( fd_map.size() > events.size() )
+			events.resize(fd_map.size());
+
+		Wakeup("RegisterFd");
+		return true;
+		}
+	else
+		{
+		reporter->Error("Failed to register fd %d from %s: %s", fd, src->Tag(), strerror(errno));
+		return false;
+		}
+	}
+
+bool Manager::UnregisterFd(int fd, IOSource* src)
+	{
+	if ( fd_map.find(fd) != fd_map.end() )
+		{
+		// The fd may have been closed already, which removes it from the
+		// epoll set by itself.
+		int ret = epoll_ctl(event_queue, EPOLL_CTL_DEL, fd, nullptr);
+		if ( ret != -1 )
+			DBG_LOG(DBG_MAINLOOP, "Unregistered fd %d from %s", fd, src->Tag());
+
+		fd_map.erase(fd);
+
+		Wakeup("UnregisterFd");
+		return true;
+		}
+	else
+		{
+		reporter->Error("Attempted to unregister an unknown file descriptor %d from %s", fd, src->Tag());
+		return false;
+		}
+	}
+
+#else
+
+void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* timeout_src)
+	{
+	++stats.polls;
+
 	struct timespec kqueue_timeout;
 	ConvertTimeout(timeout, kqueue_timeout);
 
@@ -199,6 +350,8 @@ void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* time
 		}
 	else if ( ret == 0 )
 		{
+		++stats.poll_timeouts;
+
 		if ( timeout_src )
 			ready->push_back(timeout_src);
 		}
@@ -210,7 +363,7 @@ void Manager::Poll(std::vector<IOSource*>* ready, double timeout, IOSource* time
 			{
 			if ( events[i].filter == EVFILT_READ )
 				{
-				std::map<int, IOSource*>::const_iterator it = fd_map.find(events[i].ident);
+				auto it = fd_map.find(events[i].ident);
 				if ( it != fd_map.end() )
 					ready->push_back(it->second);
 				}
@@ -278,6 +431,8 @@ bool Manager::UnregisterFd(int fd, IOSource* src)
 		}
 	}
 
+#endif
+
 void Manager::Register(IOSource* src, bool dont_count, bool manage_lifetime)
 	{
 	// First see if we already have registered that source. If so, just
@@ -418,4 +573,13 @@ PktDumper* Manager::OpenPktDumper(const std::string& path, bool append)
 	return pd;
 	}
 
+void Manager::ClosePktDumpers()
+	{
+	for ( auto* pd : pkt_dumpers )
+		{
+		if ( pd->IsOpen() )
+			pd->Done();
+		}
+	}
+
 } // namespace zeek::iosource
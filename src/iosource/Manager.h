@@ -4,15 +4,20 @@
 
 #include "zeek/zeek-config.h"
 
+#include <cstdint>
 #include <string>
+#include <unordered_map>
 #include <vector>
-#include <map>
 
 #include "zeek/iosource/IOSource.h"
 #include "zeek/Flare.h"
 
 struct timespec;
+#ifdef HAVE_EPOLL
+struct epoll_event;
+#else
 struct kevent;
+#endif
 
 namespace zeek {
 namespace iosource {
@@ -26,6 +31,17 @@ class PktDumper;
  */
 class Manager {
 public:
+	/**
+	 * Counters describing how the main loop waits for input.
+	 */
+	struct Stats {
+		uint64_t polls = 0;         /**< Calls into the kernel to wait for ready sources. */
+		uint64_t poll_timeouts = 0; /**< Polls that ended without any source being ready. */
+		uint64_t busy_polls = 0;    /**< Times an idle live packet source was asked again without waiting. */
+		uint64_t wakeups = 0;       /**< Times the packet source delivered a packet after coming up empty. */
+		double wakeup_latency = 0;  /**< Total time from those packets' timestamps to their processing. */
+	};
+
 	/**
 	 * Constructor.
 	 */
@@ -102,6 +118,13 @@ public:
 	 */
 	PktDumper* OpenPktDumper(const std::string& path, bool append);
 
+	/**
+	 * Closes all packet dumpers that are still open. Called during
+	 * termination before the threading manager shuts down, as dumpers
+	 * may hand their writes to a thread.
+	 */
+	void ClosePktDumpers();
+
 	/**
 	 * Finds the sources that have data ready to be processed.
 	 *
@@ -131,6 +154,11 @@ public:
 	 */
 	void Wakeup(const std::string& where);
 
+	/**
+	 * Returns the counters describing how the main loop waits for input.
+	 */
+	Stats GetStats() const;
+
 private:
 
 	/**
@@ -147,11 +175,27 @@ private:
 	 */
 	void Poll(std::vector<IOSource*>* ready, double timeout, IOSource* timeout_src);
 
+	/**
+	 * Returns true if the main loop should ask the live packet source for
+	 * packets right away, rather than wait for its file descriptor to
+	 * become readable. That's the case while packets keep coming, and
+	 * for live_busy_poll_duration after the source has come up empty.
+	 */
+	bool PollPktSrcNow();
+
+#ifdef HAVE_EPOLL
+	/**
+	 * Converts a double timeout value into the milliseconds used for calls
+	 * to epoll_wait().
+	 */
+	int ConvertTimeout(double timeout);
+#else
 	/**
 	 * Converts a double timeout value into a timespec struct used for calls
 	 * to kevent().
 	 */
 	void ConvertTimeout(double timeout, struct timespec& spec);
+#endif
 
 	/**
 	 * Specialized registration method for packet sources.
@@ -201,13 +245,20 @@ private:
 	WakeupHandler* wakeup = nullptr;
 	int poll_counter = 0;
 	int poll_interval = 100;
+	double busy_poll_duration = 0.0;
 
 	int event_queue = -1;
-	std::map<int, IOSource*> fd_map;
+	std::unordered_map<int, IOSource*> fd_map;
 
-	// This is only used for the output of the call to kqueue in FindReadySources().
-	// The actual events are stored as part of the queue.
+	// This is only used for the output of the call to kqueue or epoll in
+	// FindReadySources(). The actual events are stored as part of the queue.
+#ifdef HAVE_EPOLL
+	std::vector<struct epoll_event> events;
+#else
 	std::vector<struct kevent> events;
+#endif
+
+	Stats stats;
 };
 
 } // namespace iosource
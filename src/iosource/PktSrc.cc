@@ -150,7 +150,19 @@ void PktSrc::Process()
 		return;
 
 	if ( ! ExtractNextPacketInternal() )
+		{
+		if ( props.is_live && idle_since == 0.0 )
+			idle_since = util::current_time(true);
+
 		return;
+		}
+
+	if ( idle_since != 0.0 )
+		{
+		++num_wakeups;
+		wakeup_latency += std::max(0.0, util::current_time(true) - current_packet.time);
+		idle_since = 0.0;
+		}
 
 	run_state::detail::dispatch_packet(&current_packet, this);
 
@@ -10,6 +10,8 @@
 
 struct pcap_pkthdr;
 
+namespace zeek::detail { struct ConnKey; }
+
 namespace zeek::iosource {
 
 namespace detail { class BPF_Program; }
@@ -146,6 +148,28 @@ public:
 	 */
 	bool GetCurrentPacket(const Packet** hdr);
 
+	/**
+	 * Returns true if the source has a file descriptor that becomes
+	 * readable when packets arrive, so the main loop can wait for it
+	 * rather than asking the source for packets repeatedly.
+	 */
+	bool IsSelectable() const	{ return props.selectable_fd != -1; }
+
+	/**
+	 * For live sources, returns the wallclock time at which the source
+	 * last came up empty when asked for a packet, or zero if it has
+	 * delivered one since.
+	 */
+	double IdleSince() const	{ return idle_since; }
+
+	/**
+	 * Returns how often a live source has delivered a packet after
+	 * coming up empty, and the total time between those packets'
+	 * timestamps and their processing.
+	 */
+	uint64_t NumWakeups() const	{ return num_wakeups; }
+	double WakeupLatency() const	{ return wakeup_latency; }
+
 	// PacketSource interace for derived classes to override.
 
 	/**
@@ -188,6 +212,34 @@ public:
 	 */
 	virtual void Statistics(Stats* stats) = 0;
 
+	/**
+	 * Asks the source to stop delivering the packets of a flow, for
+	 * sources that can drop them before they reach Zeek, such as in
+	 * hardware or in the kernel. The core drops the packets of shunted
+	 * flows on its own as well, so sources don't need to implement
+	 * this. Note that the core only counts the packets it sees.
+	 *
+	 * The default implementation does nothing and returns false.
+	 *
+	 * @param key The flow's key. Its ports are in network byte order.
+	 *
+	 * @param timeout The time the flow may remain idle before the core
+	 * removes the shunt again.
+	 *
+	 * @return True if the source installed the shunt.
+	 */
+	virtual bool ShuntFlow(const zeek::detail::ConnKey& key, double timeout)
+		{ return false; }
+
+	/**
+	 * Removes a shunt that ShuntFlow() installed. The default
+	 * implementation does nothing.
+	 *
+	 * @param key The flow's key, as passed to ShuntFlow().
+	 */
+	virtual void UnshuntFlow(const zeek::detail::ConnKey& key)
+		{ }
+
 	/**
 	 * Return the next timeout value for this source. This should be
 	 * overridden by source classes where they have a timeout value
@@ -345,6 +397,10 @@ private:
 	bool have_packet;
 	Packet current_packet;
 
+	double idle_since = 0.0;
+	uint64_t num_wakeups = 0;
+	double wakeup_latency = 0.0;
+
 	// For BPF filtering support.
 	std::vector<detail::BPF_Program *> filters;
 
@@ -0,0 +1,241 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/iosource/pcap/DumpWriter.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include "zeek/util.h"
+
+namespace zeek::iosource::pcap::detail {
+
+// Amount of packet data collected before handing it to the writer thread
+// while the thread is still busy with earlier batches.
+static constexpr size_t BATCH_SIZE = 64 * 1024;
+
+class DumpTruncateMessage final : public threading::InputMessage<DumpWriter>
+{
+public:
+	DumpTruncateMessage(DumpWriter* writer, DumpWriter::FilePtr arg_file)
+		: threading::InputMessage<DumpWriter>("DumpTruncate", writer),
+		file(std::move(arg_file))
+		{ }
+
+	bool Process() override
+		{
+		Object()->DoTruncate(file.get());
+		return true;
+		}
+
+private:
+	DumpWriter::FilePtr file;
+};
+
+class DumpWriteMessage final : public threading::InputMessage<DumpWriter>
+{
+public:
+	DumpWriteMessage(DumpWriter* writer, DumpWriter::FilePtr arg_file,
+	                 std::vector<u_char> arg_data)
+		: threading::InputMessage<DumpWriter>("DumpWrite", writer),
+		file(std::move(arg_file)), data(std::move(arg_data))
+		{ }
+
+	bool Process() override
+		{
+		Object()->DoWrite(file.get(), data);
+		return true;
+		}
+
+private:
+	DumpWriter::FilePtr file;
+	std::vector<u_char> data;
+};
+
+class DumpCloseMessage final : public threading::InputMessage<DumpWriter>
+{
+public:
+	DumpCloseMessage(DumpWriter* writer, DumpWriter::FilePtr arg_file)
+		: threading::InputMessage<DumpWriter>("DumpClose", writer),
+		file(std::move(arg_file))
+		{ }
+
+	bool Process() override
+		{
+		Object()->DoClose(file.get());
+		return true;
+		}
+
+private:
+	DumpWriter::FilePtr file;
+};
+
+DumpWriter* DumpWriter::instance = nullptr;
+
+DumpWriter::DumpWriter()
+	{
+	SetName("pcap-dump-writer");
+	}
+
+DumpWriter::~DumpWriter()
+	{
+	if ( instance == this )
+		instance = nullptr;
+	}
+
+DumpWriter* DumpWriter::Get()
+	{
+	if ( ! instance )
+		{
+		instance = new DumpWriter();
+		instance->Start();
+		}
+
+	return instance;
+	}
+
+DumpWriter::Stats DumpWriter::GetStats()
+	{
+	Stats s = {};
+
+	if ( ! instance )
+		return s;
+
+	s.queued_bytes = instance->queued_bytes;
+	s.written_bytes = instance->written_bytes;
+	s.dropped_packets = instance->dropped_packets;
+	s.dropped_bytes = instance->dropped_bytes;
+	s.writes = instance->writes;
+	s.write_errors = instance->write_errors;
+	return s;
+	}
+
+DumpWriter::FilePtr DumpWriter::Open(const std::string& path, bool append, uint64_t max_queued)
+	{
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : 0), 0666);
+
+	if ( fd < 0 )
+		return nullptr;
+
+	auto f = std::make_shared<File>(path, fd, max_queued);
+	f->batch.reserve(BATCH_SIZE);
+
+	if ( ! append )
+		SendIn(new DumpTruncateMessage(this, f));
+
+	return f;
+	}
+
+void DumpWriter::WriteRaw(const FilePtr& f, const u_char* data, size_t len)
+	{
+	f->batch.insert(f->batch.end(), data, data + len);
+	queued_bytes += len;
+	}
+
+bool DumpWriter::Write(const FilePtr& f, const pkt_timeval& ts, uint32_t caplen, uint32_t len,
+                       const u_char* data)
+	{
+	size_t size = 16 + caplen;
+
+	if ( f->max_queued > 0 && f->queued_bytes + f->batch.size() + size > f->max_queued )
+		{
+		++dropped_packets;
+		dropped_bytes += size;
+		return false;
+		}
+
+	// The on-disk record header uses 32-bit timestamps, like pcap_dump().
+	uint32_t hdr[4] = {
+		static_cast<uint32_t>(ts.tv_sec),
+		static_cast<uint32_t>(ts.tv_usec),
+		caplen,
+		len,
+	};
+
+	auto* p = reinterpret_cast<const u_char*>(hdr);
+	f->batch.insert(f->batch.end(), p, p + sizeof(hdr));
+	f->batch.insert(f->batch.end(), data, data + caplen);
+	queued_bytes += size;
+
+	// Keep latency low while the thread is idle, and batch up writes
+	// once it falls behind.
+	if ( f->batch.size() >= BATCH_SIZE || f->queued_bytes == 0 )
+		Flush(f);
+
+	return true;
+	}
+
+void DumpWriter::Flush(const FilePtr& f)
+	{
+	if ( f->batch.empty() )
+		return;
+
+	f->queued_bytes += f->batch.size();
+	SendIn(new DumpWriteMessage(this, f, std::move(f->batch)));
+
+	f->batch = std::vector<u_char>();
+	f->batch.reserve(BATCH_SIZE);
+	}
+
+void DumpWriter::Close(const FilePtr& f)
+	{
+	Flush(f);
+	SendIn(new DumpCloseMessage(this, f));
+	}
+
+void DumpWriter::Fail(File* f, const char* msg)
+	{
+	Error(msg);
+	f->error = msg;
+	f->failed = true;
+	}
+
+void DumpWriter::DoTruncate(File* f)
+	{
+	if ( ftruncate(f->fd, 0) < 0 )
+		Fail(f, Fmt("cannot truncate %s: %s", f->path.c_str(), Strerror(errno)));
+	}
+
+void DumpWriter::DoWrite(File* f, const std::vector<u_char>& data)
+	{
+	uint64_t len = data.size();
+
+	if ( ! f->failed )
+		{
+		const u_char* p = data.data();
+		uint64_t remaining = len;
+
+		while ( remaining > 0 )
+			{
+			ssize_t n = write(f->fd, p, remaining);
+
+			if ( n < 0 )
+				{
+				if ( errno == EINTR )
+					continue;
+
+				++write_errors;
+				Fail(f, Fmt("cannot write to %s: %s", f->path.c_str(), Strerror(errno)));
+				break;
+				}
+
+			++writes;
+			written_bytes += n;
+			p += n;
+			remaining -= n;
+			}
+		}
+
+	f->queued_bytes -= len;
+	queued_bytes -= len;
+	}
+
+void DumpWriter::DoClose(File* f)
+	{
+	if ( close(f->fd) < 0 )
+		Error(Fmt("cannot close %s: %s", f->path.c_str(), Strerror(errno)));
+
+	f->fd = -1;
+	}
+
+} // namespace zeek::iosource::pcap::detail
@@ -0,0 +1,144 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zeek/iosource/Packet.h"
+#include "zeek/threading/MsgThread.h"
+
+namespace zeek::iosource::pcap::detail {
+
+/**
+ * A thread performing the disk writes of packet dumpers, so that slow or
+ * busy storage doesn't stall packet processing.  The main thread copies
+ * packets into batches and hands each batch to the thread as a message.
+ * At most Pcap::async_dump_buffer_size bytes per dump file may be waiting
+ * to be written; packets beyond that are dropped rather than making the
+ * main thread wait.  Closing a file is queued as well, so it doesn't wait
+ * for the pending writes either.
+ */
+class DumpWriter final : public threading::MsgThread {
+public:
+	/**
+	 * State of a single dump file, shared between the main thread and the
+	 * writer thread.
+	 */
+	struct File {
+		File(std::string arg_path, int arg_fd, uint64_t arg_max_queued)
+			: path(std::move(arg_path)), fd(arg_fd), max_queued(arg_max_queued)
+			{ }
+
+		std::string path;
+		int fd;
+		uint64_t max_queued;
+		std::vector<u_char> batch; // Only accessed by the main thread.
+		std::atomic<uint64_t> queued_bytes{0};
+		std::atomic<bool> failed{false};
+		std::string error; // Set by the writer thread before failed.
+	};
+
+	using FilePtr = std::shared_ptr<File>;
+
+	/**
+	 * Counters describing the writer's activity since startup.
+	 */
+	struct Stats {
+		uint64_t queued_bytes;    /**< Bytes currently waiting to be written. */
+		uint64_t written_bytes;   /**< Bytes written to disk. */
+		uint64_t dropped_packets; /**< Packets dropped because a queue was full. */
+		uint64_t dropped_bytes;   /**< Bytes of the dropped packets. */
+		uint64_t writes;          /**< Number of write system calls. */
+		uint64_t write_errors;    /**< Number of failed writes. */
+	};
+
+	/**
+	 * Returns the writer instance, creating and starting the thread on
+	 * first use.  Must only be called from the main thread.
+	 */
+	static DumpWriter* Get();
+
+	/**
+	 * Returns the writer's counters, or all zeroes if no writer has been
+	 * started.
+	 */
+	static Stats GetStats();
+
+	/**
+	 * Opens a dump file.  Called from the main thread so that errors are
+	 * reported synchronously.  A file that isn't appended to gets
+	 * truncated by the writer thread, once it has finished the writes
+	 * still pending for an earlier file of the same path.
+	 * @param path the path of the file.
+	 * @param append whether to append to the file's existing content.
+	 * @param max_queued the maximum number of bytes waiting to be
+	 *        written; zero means no limit.
+	 * @return the file's state, or null if it couldn't be opened, in
+	 *         which case errno is set.
+	 */
+	FilePtr Open(const std::string& path, bool append, uint64_t max_queued);
+
+	/**
+	 * Queues raw bytes for writing, such as the file header.
+	 */
+	void WriteRaw(const FilePtr& f, const u_char* data, size_t len);
+
+	/**
+	 * Queues a packet for writing, unless the file's queue is full.
+	 *
+	 * @return false if the packet was dropped, else true.
+	 */
+	bool Write(const FilePtr& f, const pkt_timeval& ts, uint32_t caplen, uint32_t len,
+	           const u_char* data);
+
+	/**
+	 * Queues closing a file once all its pending writes are done.
+	 */
+	void Close(const FilePtr& f);
+
+	/**
+	 * Truncates a file.  Executed by the writer thread.
+	 */
+	void DoTruncate(File* f);
+
+	/**
+	 * Writes a batch to a file.  Executed by the writer thread.
+	 */
+	void DoWrite(File* f, const std::vector<u_char>& data);
+
+	/**
+	 * Closes a file.  Executed by the writer thread.
+	 */
+	void DoClose(File* f);
+
+protected:
+	~DumpWriter() override;
+
+	bool OnHeartbeat(double network_time, double current_time) override
+		{ return true; }
+	bool OnFinish(double network_time) override
+		{ return true; }
+
+private:
+	DumpWriter();
+
+	void Flush(const FilePtr& f);
+	void Fail(File* f, const char* msg);
+
+	std::atomic<uint64_t> queued_bytes{0};
+	std::atomic<uint64_t> written_bytes{0};
+	std::atomic<uint64_t> dropped_packets{0};
+	std::atomic<uint64_t> dropped_bytes{0};
+	std::atomic<uint64_t> writes{0};
+	std::atomic<uint64_t> write_errors{0};
+
+	static DumpWriter* instance;
+};
+
+} // namespace zeek::iosource::pcap::detail
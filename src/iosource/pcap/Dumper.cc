@@ -4,6 +4,7 @@
 
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include "zeek/iosource/PktSrc.h"
 #include "zeek/RunState.h"
@@ -24,18 +25,42 @@ PcapDumper::~PcapDumper()
 	{
 	}
 
-void PcapDumper::Open()
+bool PcapDumper::CheckExisting()
 	{
-	int linktype = -1;
+	FILE* f = fopen(props.path.c_str(), "r");
 
-	pd = pcap_open_dead(DLT_EN10MB, BifConst::Pcap::snaplen);
+	if ( ! f )
+		{
+		Error(util::fmt("can't open dump %s: %s", props.path.c_str(), strerror(errno)));
+		return false;
+		}
 
-	if ( ! pd )
+	struct pcap_file_header hdr;
+	size_t n = fread(&hdr, sizeof(hdr), 1, f);
+	fclose(f);
+
+	if ( n != 1 || hdr.magic != 0xa1b2c3d4 )
 		{
-		Error("error for pcap_open_dead");
-		return;
+		Error(util::fmt("can't append to %s: not a pcap file in native byte order",
+		                props.path.c_str()));
+		return false;
+		}
+
+	// Appended records must match the link type the file declares.
+	int linktype = hdr.linktype;
+
+	if ( linktype != DLT_EN10MB )
+		{
+		Error(util::fmt("can't append to %s: link type %d differs from %d",
+		                props.path.c_str(), linktype, DLT_EN10MB));
+		return false;
 		}
 
+	return true;
+	}
+
+void PcapDumper::Open()
+	{
 	if ( props.path.empty() )
 		{
 		Error("no filename given");
@@ -55,6 +80,24 @@ void PcapDumper::Open()
 			Error(util::fmt("can't stat file %s: %s", props.path.c_str(), strerror(errno)));
 			return;
 			}
+
+		if ( exists == 0 && s.st_size > 0 && ! CheckExisting() )
+			return;
+		}
+
+	if ( BifConst::Pcap::async_dump )
+		{
+		// Writes its own file header, so it doesn't need a pcap_t.
+		OpenAsync(append && exists == 0 && s.st_size > 0);
+		return;
+		}
+
+	pd = pcap_open_dead(DLT_EN10MB, BifConst::Pcap::snaplen);
+
+	if ( ! pd )
+		{
+		Error("error for pcap_open_dead");
+		return;
 		}
 
 	if ( ! append || exists < 0 || s.st_size == 0 )
@@ -86,8 +129,47 @@ void PcapDumper::Open()
 	Opened(props);
 	}
 
+void PcapDumper::OpenAsync(bool exists)
+	{
+	auto writer = detail::DumpWriter::Get();
+	file = writer->Open(props.path, exists, BifConst::Pcap::async_dump_buffer_size);
+
+	if ( ! file )
+		{
+		Error(util::fmt("can't open dump %s: %s", props.path.c_str(), strerror(errno)));
+		return;
+		}
+
+	if ( ! exists )
+		{
+		// The same header that pcap_dump_open() writes.
+		struct pcap_file_header hdr;
+		hdr.magic = 0xa1b2c3d4;
+		hdr.version_major = PCAP_VERSION_MAJOR;
+		hdr.version_minor = PCAP_VERSION_MINOR;
+		hdr.thiszone = 0;
+		hdr.sigfigs = 0;
+		hdr.snaplen = BifConst::Pcap::snaplen;
+		hdr.linktype = DLT_EN10MB;
+		writer->WriteRaw(file, reinterpret_cast<const u_char*>(&hdr), sizeof(hdr));
+		}
+
+	props.open_time = run_state::network_time;
+	Opened(props);
+	}
+
 void PcapDumper::Close()
 	{
+	if ( file )
+		{
+		// The writer thread closes the file once it has written the
+		// queued packets; errors from then on go to the reporter.
+		detail::DumpWriter::Get()->Close(file);
+		file.reset();
+		Closed();
+		return;
+		}
+
 	if ( ! dumper )
 		return;
 
@@ -101,6 +183,20 @@ void PcapDumper::Close()
 
 bool PcapDumper::Dump(const Packet* pkt)
 	{
+	if ( file )
+		{
+		if ( file->failed )
+			{
+			Error(file->error);
+			return false;
+			}
+
+		// A full queue drops the packet, which DumpWriter counts;
+		// recording must never hold up packet processing.
+		detail::DumpWriter::Get()->Write(file, pkt->ts, pkt->cap_len, pkt->len, pkt->data);
+		return true;
+		}
+
 	if ( ! dumper )
 		return false;
 
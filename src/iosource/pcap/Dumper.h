@@ -6,7 +6,10 @@ extern "C" {
 #include <pcap.h>
 }
 
+#include <memory>
+
 #include "zeek/iosource/PktDumper.h"
+#include "zeek/iosource/pcap/DumpWriter.h"
 
 namespace zeek::iosource::pcap {
 
@@ -24,11 +27,17 @@ protected:
 	bool Dump(const Packet* pkt) override;
 
 private:
+	void OpenAsync(bool exists);
+	bool CheckExisting();
+
 	Properties props;
 
 	bool append;
 	pcap_dumper_t* dumper;
 	pcap_t* pd;
+
+	// Used instead of dumper when Pcap::async_dump is set.
+	detail::DumpWriter::FilePtr file;
 };
 
 } // namespace zeek::iosource::pcap
@@ -37,11 +37,16 @@ void PcapSource::Open()
 
 void PcapSource::Close()
 	{
-	if ( ! pd )
+	if ( ! pd && ! trace )
 		return;
 
-	pcap_close(pd);
-	pd = nullptr;
+	if ( pd )
+		{
+		pcap_close(pd);
+		pd = nullptr;
+		}
+
+	trace.reset();
 
 	Closed();
 
@@ -169,6 +174,29 @@ void PcapSource::OpenLive()
 
 void PcapSource::OpenOffline()
 	{
+	if ( BifConst::Pcap::native_trace_reader )
+		{
+		std::string error;
+		trace = detail::TraceReader::Open(props.path, &error);
+
+		if ( trace )
+			{
+			props.selectable_fd = trace->Fd();
+			props.link_type = trace->LinkType();
+			props.is_live = false;
+			Opened(props);
+			return;
+			}
+
+		if ( ! error.empty() )
+			{
+			Error(error);
+			return;
+			}
+
+		// Not something we can read ourselves, leave it to libpcap.
+		}
+
 	char errbuf[PCAP_ERRBUF_SIZE];
 
 	pd = pcap_open_offline(props.path.c_str(), errbuf);
@@ -192,6 +220,9 @@ void PcapSource::OpenOffline()
 
 bool PcapSource::ExtractNextPacket(Packet* pkt)
 	{
+	if ( trace )
+		return ExtractNextTracePacket(pkt);
+
 	if ( ! pd )
 		return false;
 
@@ -248,6 +279,48 @@ bool PcapSource::ExtractNextPacket(Packet* pkt)
 	return true;
 	}
 
+bool PcapSource::ExtractNextTracePacket(Packet* pkt)
+	{
+	pcap_pkthdr header;
+	const u_char* data;
+
+	while ( true )
+		{
+		if ( ! trace->Next(&header, &data) )
+			{
+			if ( ! trace->Error().empty() )
+				reporter->FatalError("failed to read a packet from %s: %s",
+				                     props.path.data(), trace->Error().c_str());
+
+			// Exhausted trace file, no more packets to read.
+			Close();
+			return false;
+			}
+
+		// libpcap applies filters to offline sources itself, so we need
+		// to do it here.
+		if ( trace_filter < 0 || ApplyBPFFilter(trace_filter, &header, data) )
+			break;
+
+		if ( ! trace )
+			// The filter has gone away and the source was closed.
+			return false;
+		}
+
+	pkt->Init(props.link_type, &header.ts, header.caplen, header.len, data);
+
+	if ( header.len == 0 || header.caplen == 0 )
+		{
+		Weird("empty_pcap_header", pkt);
+		return false;
+		}
+
+	++stats.received;
+	stats.bytes_received += header.len;
+
+	return true;
+	}
+
 void PcapSource::DoneWithPacket()
 	{
 	// Nothing to do.
@@ -260,7 +333,7 @@ bool PcapSource::PrecompileFilter(int index, const std::string& filter)
 
 bool PcapSource::SetFilter(int index)
 	{
-	if ( ! pd )
+	if ( ! pd && ! trace )
 		return true; // Prevent error message
 
 	char errbuf[PCAP_ERRBUF_SIZE];
@@ -283,6 +356,8 @@ bool PcapSource::SetFilter(int index)
 		// since the default scripts will always attempt to compile
 		// and install a default filter
 		}
+	else if ( trace )
+		trace_filter = index;
 	else
 		{
 		if ( pcap_setfilter(pd, code->GetProgram()) < 0 )
@@ -9,6 +9,7 @@ extern "C" {
 }
 
 #include "zeek/iosource/PktSrc.h"
+#include "zeek/iosource/pcap/TraceReader.h"
 
 namespace zeek::iosource::pcap {
 
@@ -32,12 +33,17 @@ protected:
 private:
 	void OpenLive();
 	void OpenOffline();
+	bool ExtractNextTracePacket(Packet* pkt);
 	void PcapError(const char* where = nullptr);
 
 	Properties props;
 	Stats stats;
 
 	pcap_t *pd;
+
+	// Used instead of pd for offline sources that we can read natively.
+	std::unique_ptr<detail::TraceReader> trace;
+	int trace_filter = -1;
 };
 
 } // namespace zeek::iosource::pcap
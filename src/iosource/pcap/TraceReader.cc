@@ -0,0 +1,828 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/zeek-config.h"
+#include "zeek/iosource/pcap/TraceReader.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "zeek/util.h"
+
+namespace zeek::iosource::pcap::detail {
+
+// Magic numbers identifying the supported formats.
+static constexpr uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+static constexpr uint32_t PCAP_MAGIC_SWAPPED = 0xd4c3b2a1;
+static constexpr uint32_t PCAP_NSEC_MAGIC = 0xa1b23c4d;
+static constexpr uint32_t PCAP_NSEC_MAGIC_SWAPPED = 0x4d3cb2a1;
+static constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+// pcapng block types.
+static constexpr uint32_t BT_SHB = 0x0a0d0d0a;
+static constexpr uint32_t BT_IDB = 0x00000001;
+static constexpr uint32_t BT_PB = 0x00000002;
+static constexpr uint32_t BT_SPB = 0x00000003;
+static constexpr uint32_t BT_EPB = 0x00000006;
+
+// pcapng interface description options.
+static constexpr uint16_t OPT_ENDOFOPT = 0;
+static constexpr uint16_t OPT_IF_TSRESOL = 9;
+static constexpr uint16_t OPT_IF_TSOFFSET = 14;
+
+// Upper bound on record sizes, guarding against corrupt length fields.
+static constexpr uint32_t MAX_RECORD_SIZE = 256 * 1024 * 1024;
+
+// How far ahead of the current position to prefetch mapped files.
+static constexpr size_t READAHEAD = 64 * 1024 * 1024;
+
+// Size of the chunks a compressed file is inflated into, and how many of
+// them the helper thread may buffer ahead of the reader.
+static constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024;
+static constexpr size_t MAX_CHUNKS = 4;
+
+/**
+ * A source of trace file bytes.
+ */
+class TraceInput {
+public:
+	virtual ~TraceInput() = default;
+
+	/**
+	 * Returns the next *len* bytes. The pointer remains valid until the
+	 * next call.
+	 *
+	 * @return null if fewer than *len* bytes remain, or on error. Partial()
+	 *         then tells whether there were any bytes left at all.
+	 */
+	virtual const u_char* Read(size_t len) = 0;
+
+	virtual int Fd() const = 0;
+
+	bool Partial() const	{ return partial; }
+	const std::string& Error() const	{ return error; }
+
+protected:
+	bool partial = false;
+	std::string error;
+};
+
+/**
+ * Input from a memory-mapped, uncompressed file.
+ */
+class MmapInput final : public TraceInput {
+public:
+	MmapInput(int arg_fd, const u_char* arg_base, size_t arg_size)
+		: fd(arg_fd), base(arg_base), size(arg_size)
+		{
+		page_size = sysconf(_SC_PAGESIZE);
+#ifdef MADV_SEQUENTIAL
+		madvise(const_cast<u_char*>(base), size, MADV_SEQUENTIAL);
+#endif
+		Readahead();
+		}
+
+	~MmapInput() override
+		{
+		munmap(const_cast<u_char*>(base), size);
+		close(fd);
+		}
+
+	const u_char* Read(size_t len) override
+		{
+		if ( size - pos < len )
+			{
+			partial = pos < size;
+			pos = size;
+			return nullptr;
+			}
+
+		const u_char* p = base + pos;
+		pos += len;
+
+		if ( pos + READAHEAD / 2 > advised )
+			Readahead();
+
+		return p;
+		}
+
+	int Fd() const override	{ return fd; }
+
+private:
+	// Asks the kernel to page in the window ahead of the current position,
+	// and to drop the pages well behind it so that large traces don't
+	// grow the resident set.
+	void Readahead()
+		{
+		size_t start = advised & ~(page_size - 1);
+		advised = std::min(size, pos + READAHEAD);
+
+#ifdef MADV_WILLNEED
+		if ( advised > start )
+			madvise(const_cast<u_char*>(base + start), advised - start, MADV_WILLNEED);
+#endif
+
+#ifdef MADV_DONTNEED
+		if ( pos > READAHEAD )
+			{
+			size_t done = (pos - READAHEAD) & ~(page_size - 1);
+
+			if ( done > released )
+				{
+				madvise(const_cast<u_char*>(base + released), done - released,
+				        MADV_DONTNEED);
+				released = done;
+				}
+			}
+#endif
+		}
+
+	int fd;
+	const u_char* base;
+	size_t size;
+	size_t pos = 0;
+	size_t advised = 0;
+	size_t released = 0;
+	size_t page_size;
+};
+
+/**
+ * Input from a gzip-compressed file, inflated by a helper thread.
+ */
+class GzipInput final : public TraceInput {
+public:
+	GzipInput(int arg_fd, gzFile arg_gz) : fd(arg_fd), gz(arg_gz)
+		{
+		gzbuffer(gz, 1024 * 1024);
+		thread = std::thread(&GzipInput::Inflate, this);
+		}
+
+	~GzipInput() override
+		{
+			{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+			}
+
+		space.notify_all();
+		thread.join();
+
+		gzclose(gz);
+		close(fd);
+		}
+
+	const u_char* Read(size_t len) override
+		{
+		if ( current.size() - current_pos >= len )
+			{
+			const u_char* p = current.data() + current_pos;
+			current_pos += len;
+			return p;
+			}
+
+		// The record straddles chunks; assemble it in the scratch buffer.
+		scratch.assign(current.begin() + current_pos, current.end());
+		current_pos = current.size();
+
+		while ( scratch.size() < len )
+			{
+			if ( ! NextChunk() )
+				{
+				partial = ! scratch.empty();
+				return nullptr;
+				}
+
+			size_t n = std::min(len - scratch.size(), current.size());
+			scratch.insert(scratch.end(), current.begin(), current.begin() + n);
+			current_pos = n;
+			}
+
+		return scratch.data();
+		}
+
+	int Fd() const override	{ return fd; }
+
+private:
+	bool NextChunk()
+		{
+		std::unique_lock<std::mutex> lock(mutex);
+		ready.wait(lock, [this] { return ! chunks.empty() || done; });
+
+		if ( ! current.empty() )
+			free_chunks.push_back(std::move(current));
+
+		current.clear();
+		current_pos = 0;
+
+		if ( chunks.empty() )
+			{
+			error = inflate_error;
+			return false;
+			}
+
+		current = std::move(chunks.front());
+		chunks.pop_front();
+		space.notify_one();
+		return true;
+		}
+
+	// The helper thread's main function.
+	void Inflate()
+		{
+		// Signals are handled by the main thread only, like for all our
+		// other threads.
+		sigset_t mask_set;
+		sigfillset(&mask_set);
+		sigdelset(&mask_set, SIGFPE);
+		sigdelset(&mask_set, SIGILL);
+		sigdelset(&mask_set, SIGSEGV);
+		sigdelset(&mask_set, SIGBUS);
+		pthread_sigmask(SIG_BLOCK, &mask_set, nullptr);
+
+		while ( true )
+			{
+			std::vector<u_char> chunk;
+
+				{
+				std::unique_lock<std::mutex> lock(mutex);
+				space.wait(lock, [this] { return chunks.size() < MAX_CHUNKS || stop; });
+
+				if ( stop )
+					return;
+
+				if ( ! free_chunks.empty() )
+					{
+					chunk = std::move(free_chunks.back());
+					free_chunks.pop_back();
+					}
+				}
+
+			chunk.resize(CHUNK_SIZE);
+			int n = gzread(gz, chunk.data(), CHUNK_SIZE);
+			std::string err;
+
+			if ( n < 0 )
+				{
+				int errnum;
+				err = gzerror(gz, &errnum);
+				n = 0;
+				}
+
+			chunk.resize(n);
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if ( n > 0 )
+				chunks.push_back(std::move(chunk));
+
+			if ( n == 0 )
+				{
+				inflate_error = std::move(err);
+				done = true;
+				}
+
+			ready.notify_one();
+
+			if ( done )
+				return;
+			}
+		}
+
+	int fd;
+	gzFile gz;
+	std::thread thread;
+
+	std::mutex mutex;
+	std::condition_variable ready; // Signaled when a chunk has been queued.
+	std::condition_variable space; // Signaled when a chunk has been taken.
+	std::deque<std::vector<u_char>> chunks;
+	std::vector<std::vector<u_char>> free_chunks;
+	std::string inflate_error;
+	bool done = false;
+	bool stop = false;
+
+	// Only accessed by the reading thread.
+	std::vector<u_char> current;
+	size_t current_pos = 0;
+	std::vector<u_char> scratch;
+};
+
+// Maps a LINKTYPE_* value as found in trace files to the corresponding
+// DLT_* value, like libpcap does. The two only differ for a few historic
+// types.
+static int linktype_to_dlt(uint32_t linktype)
+	{
+	switch ( linktype ) {
+	case 100: return DLT_ATM_RFC1483;
+	case 101: return DLT_RAW;
+	case 102: return DLT_SLIP_BSDOS;
+	case 103: return DLT_PPP_BSDOS;
+	default: return static_cast<int>(linktype);
+	}
+	}
+
+TraceReader::TraceReader(std::unique_ptr<TraceInput> arg_input)
+	: input(std::move(arg_input))
+	{
+	}
+
+TraceReader::~TraceReader() = default;
+
+std::unique_ptr<TraceReader> TraceReader::Open(const std::string& path, std::string* error)
+	{
+	// Anything we can't handle is left to libpcap, including reporting
+	// errors about files that can't be opened.
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if ( fd < 0 )
+		return nullptr;
+
+	struct stat st;
+	u_char magic[4];
+
+	if ( fstat(fd, &st) < 0 || ! S_ISREG(st.st_mode) ||
+	     pread(fd, magic, sizeof(magic), 0) != sizeof(magic) )
+		{
+		close(fd);
+		return nullptr;
+		}
+
+	std::unique_ptr<TraceInput> input;
+	bool compressed = false;
+
+	if ( magic[0] == 0x1f && magic[1] == 0x8b )
+		{
+		int gz_fd = dup(fd);
+		gzFile gz = gz_fd >= 0 ? gzdopen(gz_fd, "rb") : nullptr;
+
+		if ( ! gz )
+			{
+			*error = util::fmt("cannot open %s: %s", path.c_str(), strerror(errno));
+
+			if ( gz_fd >= 0 )
+				close(gz_fd);
+
+			close(fd);
+			return nullptr;
+			}
+
+		input = std::make_unique<GzipInput>(fd, gz);
+		compressed = true;
+		}
+
+	else if ( magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd )
+		{
+		*error = util::fmt("%s: zstd-compressed traces are not supported", path.c_str());
+		close(fd);
+		return nullptr;
+		}
+
+	else
+		{
+		void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if ( base == MAP_FAILED )
+			{
+			close(fd);
+			return nullptr;
+			}
+
+		input = std::make_unique<MmapInput>(fd, static_cast<const u_char*>(base),
+		                                    st.st_size);
+		}
+
+	std::unique_ptr<TraceReader> reader(new TraceReader(std::move(input)));
+	const u_char* p = reader->input->Read(4);
+	uint32_t file_magic = 0;
+
+	if ( p )
+		memcpy(&file_magic, p, sizeof(file_magic));
+
+	bool ok;
+
+	if ( file_magic == BT_SHB )
+		{
+		reader->pcapng = true;
+		ok = reader->ReadPcapngHeader();
+		}
+	else
+		ok = reader->ReadPcapHeader(file_magic);
+
+	if ( ! ok )
+		{
+		// Unknown formats in uncompressed files are left to libpcap.
+		if ( ! reader->error.empty() )
+			*error = util::fmt("%s: %s", path.c_str(), reader->error.c_str());
+		else if ( compressed )
+			*error = util::fmt("%s: unknown file format", path.c_str());
+
+		return nullptr;
+		}
+
+	return reader;
+	}
+
+int TraceReader::Fd() const
+	{
+	return input->Fd();
+	}
+
+uint16_t TraceReader::Get16(const u_char* p) const
+	{
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? __builtin_bswap16(v) : v;
+	}
+
+uint32_t TraceReader::Get32(const u_char* p) const
+	{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return swapped ? __builtin_bswap32(v) : v;
+	}
+
+bool TraceReader::Truncated()
+	{
+	if ( ! input->Error().empty() )
+		error = input->Error();
+	else
+		error = "truncated dump file";
+
+	return false;
+	}
+
+bool TraceReader::ReadPcapHeader(uint32_t magic)
+	{
+	switch ( magic ) {
+	case PCAP_MAGIC: break;
+	case PCAP_MAGIC_SWAPPED: swapped = true; break;
+	case PCAP_NSEC_MAGIC: nsecs = true; break;
+	case PCAP_NSEC_MAGIC_SWAPPED: swapped = nsecs = true; break;
+	default: return false;
+	}
+
+	// Version, time zone, sigfigs, snaplen and link type.
+	const u_char* p = input->Read(20);
+
+	if ( ! p )
+		return Truncated();
+
+	// The upper bits hold FCS information, which we don't need.
+	link_type = linktype_to_dlt(Get32(p + 16) & 0x03ffffff);
+	return true;
+	}
+
+bool TraceReader::ReadPcapngHeader()
+	{
+	if ( ! ReadSectionHeader(nullptr) )
+		return false;
+
+	// The link type comes from the first interface description, which
+	// must precede any packets.
+	while ( interfaces.empty() )
+		{
+		uint32_t type;
+		const u_char* body;
+		uint32_t body_len;
+
+		if ( ! ReadBlock(&type, &body, &body_len) )
+			{
+			if ( error.empty() )
+				error = "no interface description in pcapng file";
+
+			return false;
+			}
+
+		if ( type == BT_EPB || type == BT_SPB || type == BT_PB )
+			{
+			error = "packet before interface description in pcapng file";
+			return false;
+			}
+
+		if ( type == BT_IDB && ! AddInterface(body, body_len) )
+			return false;
+		}
+
+	return true;
+	}
+
+bool TraceReader::Next(struct pcap_pkthdr* hdr, const u_char** data)
+	{
+	if ( ! error.empty() )
+		return false;
+
+	return pcapng ? NextPcapng(hdr, data) : NextPcap(hdr, data);
+	}
+
+bool TraceReader::NextPcap(struct pcap_pkthdr* hdr, const u_char** data)
+	{
+	const u_char* p = input->Read(16);
+
+	if ( ! p )
+		{
+		if ( input->Partial() || ! input->Error().empty() )
+			Truncated();
+
+		return false;
+		}
+
+	uint32_t usecs = Get32(p + 4);
+
+	hdr->ts.tv_sec = Get32(p);
+	hdr->ts.tv_usec = nsecs ? usecs / 1000 : usecs;
+	hdr->caplen = Get32(p + 8);
+	hdr->len = Get32(p + 12);
+
+	if ( hdr->caplen > MAX_RECORD_SIZE )
+		{
+		error = util::fmt("invalid packet capture length %u", hdr->caplen);
+		return false;
+		}
+
+	*data = input->Read(hdr->caplen);
+
+	if ( ! *data )
+		return Truncated();
+
+	return true;
+	}
+
+bool TraceReader::NextPcapng(struct pcap_pkthdr* hdr, const u_char** data)
+	{
+	while ( true )
+		{
+		uint32_t type;
+		const u_char* body;
+		uint32_t body_len;
+
+		if ( ! ReadBlock(&type, &body, &body_len) )
+			return false;
+
+		switch ( type ) {
+		case BT_IDB:
+			if ( ! AddInterface(body, body_len) )
+				return false;
+
+			break;
+
+		case BT_EPB:
+		case BT_PB:
+			{
+			if ( body_len < 20 )
+				{
+				error = "packet block too short";
+				return false;
+				}
+
+			uint32_t id = type == BT_EPB ? Get32(body) : Get16(body);
+
+			if ( id >= interfaces.size() )
+				{
+				error = util::fmt("packet for unknown interface %u", id);
+				return false;
+				}
+
+			uint64_t ts = (static_cast<uint64_t>(Get32(body + 4)) << 32) | Get32(body + 8);
+
+			SetTimestamp(hdr, interfaces[id], ts);
+			hdr->caplen = Get32(body + 12);
+			hdr->len = Get32(body + 16);
+
+			if ( hdr->caplen > body_len - 20 )
+				{
+				error = util::fmt("invalid packet capture length %u", hdr->caplen);
+				return false;
+				}
+
+			*data = body + 20;
+			return true;
+			}
+
+		case BT_SPB:
+			{
+			if ( body_len < 4 || interfaces.empty() )
+				{
+				error = "invalid simple packet block";
+				return false;
+				}
+
+			// Simple packet blocks carry no timestamp, and libpcap
+			// reports them with a zero one, too.
+			const auto& iface = interfaces[0];
+			hdr->ts.tv_sec = 0;
+			hdr->ts.tv_usec = 0;
+			hdr->len = Get32(body);
+			hdr->caplen = std::min(hdr->len, body_len - 4);
+
+			if ( iface.snaplen > 0 && hdr->caplen > iface.snaplen )
+				hdr->caplen = iface.snaplen;
+
+			*data = body + 4;
+			return true;
+			}
+
+		default:
+			// Skip everything else, including new section headers,
+			// which ReadBlock() has already processed.
+			break;
+		}
+		}
+	}
+
+bool TraceReader::ReadBlock(uint32_t* type, const u_char** body, uint32_t* body_len)
+	{
+	const u_char* p = input->Read(8);
+
+	if ( ! p )
+		{
+		if ( input->Partial() || ! input->Error().empty() )
+			Truncated();
+
+		return false;
+		}
+
+	// The section header's type is a palindrome, so it can be recognized
+	// before knowing the section's byte order.
+	uint32_t block_type = Get32(p);
+
+	if ( block_type == BT_SHB )
+		{
+		u_char block_header[8];
+		memcpy(block_header, p, sizeof(block_header));
+
+		if ( ! ReadSectionHeader(block_header) )
+			return false;
+
+		*type = BT_SHB;
+		*body = nullptr;
+		*body_len = 0;
+		return true;
+		}
+
+	uint32_t total_len = Get32(p + 4);
+
+	if ( total_len < 12 || total_len % 4 != 0 || total_len > MAX_RECORD_SIZE )
+		{
+		error = util::fmt("invalid block length %u", total_len);
+		return false;
+		}
+
+	// Body plus trailing copy of the length.
+	p = input->Read(total_len - 8);
+
+	if ( ! p )
+		return Truncated();
+
+	*type = block_type;
+	*body = p;
+	*body_len = total_len - 12;
+	return true;
+	}
+
+bool TraceReader::ReadSectionHeader(const u_char* block_header)
+	{
+	u_char buf[8];
+
+	if ( ! block_header )
+		{
+		// Opening the file, with the block type already consumed.
+		const u_char* p = input->Read(4);
+
+		if ( ! p )
+			return Truncated();
+
+		uint32_t shb = BT_SHB;
+		memcpy(buf, &shb, 4);
+		memcpy(buf + 4, p, 4);
+		block_header = buf;
+		}
+
+	const u_char* p = input->Read(4);
+
+	if ( ! p )
+		return Truncated();
+
+	uint32_t bom;
+	memcpy(&bom, p, sizeof(bom));
+
+	if ( bom == PCAPNG_BYTE_ORDER_MAGIC )
+		swapped = false;
+	else if ( bom == __builtin_bswap32(PCAPNG_BYTE_ORDER_MAGIC) )
+		swapped = true;
+	else
+		{
+		error = "invalid byte order mark in pcapng section header";
+		return false;
+		}
+
+	uint32_t total_len = Get32(block_header + 4);
+
+	if ( total_len < 28 || total_len % 4 != 0 || total_len > MAX_RECORD_SIZE )
+		{
+		error = util::fmt("invalid section header length %u", total_len);
+		return false;
+		}
+
+	// Skip version, section length and options. Interface IDs are
+	// scoped to their section.
+	if ( ! input->Read(total_len - 12) )
+		return Truncated();
+
+	interfaces.clear();
+	return true;
+	}
+
+bool TraceReader::AddInterface(const u_char* body, uint32_t body_len)
+	{
+	if ( body_len < 8 )
+		{
+		error = "interface description too short";
+		return false;
+		}
+
+	Interface iface;
+	iface.link_type = linktype_to_dlt(Get16(body));
+	iface.snaplen = Get32(body + 4);
+	iface.units_per_sec = 1000000;
+	iface.offset = 0;
+
+	const u_char* opt = body + 8;
+	const u_char* end = body + body_len;
+
+	while ( end - opt >= 4 )
+		{
+		uint16_t code = Get16(opt);
+		uint16_t len = Get16(opt + 2);
+		const u_char* val = opt + 4;
+
+		if ( code == OPT_ENDOFOPT || len > end - val )
+			break;
+
+		if ( code == OPT_IF_TSRESOL && len >= 1 )
+			{
+			// The high bit selects between a power of two and a power
+			// of ten.
+			unsigned int exp = val[0] & 0x7f;
+			bool base2 = val[0] & 0x80;
+
+			if ( (base2 && exp > 63) || (! base2 && exp > 19) )
+				{
+				error = "unsupported timestamp resolution in pcapng file";
+				return false;
+				}
+
+			uint64_t units = 1;
+
+			for ( unsigned int i = 0; i < exp; ++i )
+				units *= base2 ? 2 : 10;
+
+			iface.units_per_sec = units;
+			}
+
+		else if ( code == OPT_IF_TSOFFSET && len >= 8 )
+			{
+			// A signed 64-bit value in the section's byte order.
+			uint64_t v;
+			memcpy(&v, val, sizeof(v));
+			iface.offset = static_cast<int64_t>(swapped ? __builtin_bswap64(v) : v);
+			}
+
+		opt = val + ((len + 3) & ~3);
+		}
+
+	// Like libpcap, we report a single link type for the whole trace.
+	if ( link_type < 0 )
+		link_type = iface.link_type;
+
+	else if ( iface.link_type != link_type )
+		{
+		error = "interfaces with different link types in pcapng file are not supported";
+		return false;
+		}
+
+	interfaces.push_back(iface);
+	return true;
+	}
+
+void TraceReader::SetTimestamp(struct pcap_pkthdr* hdr, const Interface& iface,
+                               uint64_t ts) const
+	{
+	uint64_t frac = ts % iface.units_per_sec;
+
+	hdr->ts.tv_sec = static_cast<int64_t>(ts / iface.units_per_sec) + iface.offset;
+	hdr->ts.tv_usec = static_cast<uint64_t>(static_cast<double>(frac) * 1e6 /
+	                                        static_cast<double>(iface.units_per_sec));
+	}
+
+} // namespace zeek::iosource::pcap::detail
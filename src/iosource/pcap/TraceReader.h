@@ -0,0 +1,102 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <pcap.h>
+}
+
+namespace zeek::iosource::pcap::detail {
+
+class TraceInput;
+
+/**
+ * A reader for pcap and pcapng trace files that avoids libpcap's
+ * per-packet read() and copy.  Uncompressed files are memory-mapped with
+ * sequential readahead, and packet data is handed out as pointers into the
+ * mapping.  Gzip-compressed files are inflated in large chunks by a helper
+ * thread; only packets straddling two chunks get copied.
+ */
+class TraceReader {
+public:
+	~TraceReader();
+
+	/**
+	 * Opens a trace file.
+	 *
+	 * @param path the file's path.
+	 * @param error set to a description of the problem if the file can't
+	 *        be read.
+	 * @return the reader, or null on error. If *error* remains empty, the
+	 *         file is of a kind not handled by this reader, such as a pipe
+	 *         or an unknown format, and the caller should fall back to
+	 *         libpcap.
+	 */
+	static std::unique_ptr<TraceReader> Open(const std::string& path, std::string* error);
+
+	/**
+	 * Returns the data link type of the trace, as a DLT_* value.
+	 */
+	int LinkType() const	{ return link_type; }
+
+	/**
+	 * Returns the underlying file descriptor.
+	 */
+	int Fd() const;
+
+	/**
+	 * Reads the next packet. Its data remains valid until the next call.
+	 *
+	 * @param hdr filled in with the packet's pcap header.
+	 * @param data set to the packet's data.
+	 * @return false at the end of the trace or on error, see Error().
+	 */
+	bool Next(struct pcap_pkthdr* hdr, const u_char** data);
+
+	/**
+	 * Returns a description of the last error, or an empty string if
+	 * there was none.
+	 */
+	const std::string& Error() const	{ return error; }
+
+private:
+	struct Interface {
+		int link_type;
+		uint32_t snaplen;
+		uint64_t units_per_sec;
+		int64_t offset;
+	};
+
+	explicit TraceReader(std::unique_ptr<TraceInput> input);
+
+	bool ReadPcapHeader(uint32_t magic);
+	bool ReadPcapngHeader();
+	bool NextPcap(struct pcap_pkthdr* hdr, const u_char** data);
+	bool NextPcapng(struct pcap_pkthdr* hdr, const u_char** data);
+	bool ReadBlock(uint32_t* type, const u_char** body, uint32_t* body_len);
+	bool ReadSectionHeader(const u_char* block_header);
+	bool AddInterface(const u_char* body, uint32_t body_len);
+	void SetTimestamp(struct pcap_pkthdr* hdr, const Interface& iface,
+	                  uint64_t ts) const;
+	bool Truncated();
+
+	uint16_t Get16(const u_char* p) const;
+	uint32_t Get32(const u_char* p) const;
+
+	std::unique_ptr<TraceInput> input;
+	std::string error;
+
+	bool pcapng = false;
+	bool swapped = false;
+	bool nsecs = false;
+	int link_type = -1;
+	std::vector<Interface> interfaces;
+};
+
+} // namespace zeek::iosource::pcap::detail
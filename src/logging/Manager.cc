@@ -16,6 +16,7 @@
 #include "zeek/IntrusivePtr.h"
 #include "zeek/Func.h"
 #include "zeek/Desc.h"
+#include "zeek/Stats.h"
 
 #include "zeek/broker/Manager.h"
 #include "zeek/threading/Manager.h"
@@ -93,6 +94,8 @@ struct Manager::Stream {
 
 	bool enable_remote;
 
+	uint64_t num_writes = 0;
+
 	~Stream();
 	};
 
@@ -702,6 +705,15 @@ bool Manager::RemoveFilter(EnumVal* id, const string& name)
 	return true;
 	}
 
+// Returns false if invoking a policy hook can be skipped: without bodies
+// it just returns true, unless a plugin intercepts the call or function
+// calls get sampled.
+static bool policy_needs_invoke(const Func* policy)
+	{
+	return policy->HasBodies() || zeek::detail::sample_logger ||
+	       plugin_mgr->HavePluginForHook(plugin::HOOK_CALL_FUNCTION);
+	}
+
 bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 	{
 	Stream* stream = FindStream(id);
@@ -711,6 +723,8 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 	if ( ! stream->enabled )
 		return true;
 
+	++stream->num_writes;
+
 	auto columns = columns_arg->CoerceTo({NewRef{}, stream->columns});
 
 	if ( ! columns )
@@ -725,7 +739,7 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 
 	bool stream_veto = false;
 
-	if ( log_stream_policy_hook )
+	if ( log_stream_policy_hook && policy_needs_invoke(log_stream_policy_hook.get()) )
 		{
 		auto v = log_stream_policy_hook->Invoke(columns, IntrusivePtr{NewRef{}, id});
 		if ( v && ! v->AsBool() )
@@ -746,11 +760,8 @@ bool Manager::Write(EnumVal* id, RecordVal* columns_arg)
 		string path = filter->path;
 
 		// Policy hooks may veto the logging or alter the log
-		// record if really necessary. Potential optimization:
-		// don't invoke the hook at all when it has no
-		// handlers/bodies. Doing this skips sampling and
-		// plugin hooks, though, so for now we do invoke.
-		if ( filter->policy )
+		// record if really necessary.
+		if ( filter->policy && policy_needs_invoke(filter->policy) )
 			{
 			auto v = filter->policy->Invoke(columns,
 							IntrusivePtr{NewRef{}, id},
@@ -1321,6 +1332,23 @@ bool Manager::WriteFromRemote(EnumVal* id, EnumVal* writer, const string& path,
 	return true;
 	}
 
+WriterFrontend* Manager::FindWriterForRemoteLog(EnumVal* id, EnumVal* writer,
+                                                const string& path)
+	{
+	Stream* stream = FindStream(id);
+
+	if ( ! stream || ! stream->enabled )
+		return nullptr;
+
+	Stream::WriterMap::iterator w =
+		stream->writers.find(Stream::WriterPathPair(writer->AsEnum(), path));
+
+	if ( w == stream->writers.end() )
+		return nullptr;
+
+	return w->second->writer;
+	}
+
 void Manager::SendAllWritersTo(const broker::endpoint_info& ei)
 	{
 	auto et = id::find_type("Log::Writer")->AsEnumType();
@@ -1436,6 +1464,19 @@ RecordType* Manager::StreamColumns(EnumVal* stream_id)
 	return stream->columns;
 	}
 
+std::vector<std::pair<std::string, uint64_t>> Manager::StreamWriteCounts() const
+	{
+	std::vector<std::pair<std::string, uint64_t>> counts;
+
+	for ( const auto* stream : streams )
+		{
+		if ( stream )
+			counts.emplace_back(stream->name, stream->num_writes);
+		}
+
+	return counts;
+	}
+
 // Timer which on dispatching rotates the filter.
 class RotationTimer final : public zeek::detail::Timer {
 public:
@@ -192,6 +192,18 @@ public:
 	bool WriteFromRemote(EnumVal* stream, EnumVal* writer, const std::string& path,
 	                     int num_fields, threading::Value** vals);
 
+	/**
+	 * Returns the writer that WriteFromRemote() writes to for a given
+	 * stream, writer type and path. This allows writing batches of
+	 * records received from remote without looking up the writer for
+	 * each of them.
+	 *
+	 * @return The writer, or null if it doesn't exist or the stream is
+	 * disabled.
+	 */
+	WriterFrontend* FindWriterForRemoteLog(EnumVal* stream, EnumVal* writer,
+	                                       const std::string& path);
+
 	/**
 	 * Announces all instantiated writers to a given Broker peer.
 	 */
@@ -250,6 +262,12 @@ public:
 	 */
 	RecordType* StreamColumns(EnumVal* stream_id);
 
+	/**
+	 * @return the number of records passed to Write() for each existing
+	 * stream, keyed by the stream's name.
+	 */
+	std::vector<std::pair<std::string, uint64_t>> StreamWriteCounts() const;
+
 protected:
 	friend class WriterFrontend;
 	friend class RotationFinishedMessage;
@@ -207,7 +207,8 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals)
 				writer,
 				info->path,
 				num_fields,
-				vals);
+				vals,
+				fields);
 		}
 
 	if ( ! backend )
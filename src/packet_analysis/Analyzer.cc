@@ -94,13 +94,17 @@ bool Analyzer::ForwardPacket(size_t len, const uint8_t* data, Packet* packet,
 
 	DBG_LOG(DBG_PACKET_ANALYSIS, "Analysis in %s succeeded, next layer identifier is %#x.",
 			GetAnalyzerName(), identifier);
+	++inner_analyzer->num_packets_processed;
 	return inner_analyzer->AnalyzePacket(len, data, packet);
 	}
 
 bool Analyzer::ForwardPacket(size_t len, const uint8_t* data, Packet* packet) const
 	{
 	if ( default_analyzer )
+		{
+		++default_analyzer->num_packets_processed;
 		return default_analyzer->AnalyzePacket(len, data, packet);
+		}
 
 	DBG_LOG(DBG_PACKET_ANALYSIS, "Analysis in %s stopped, no default analyzer available.",
 			GetAnalyzerName());
@@ -66,6 +66,12 @@ public:
 	 */
 	bool IsAnalyzer(const char* name);
 
+	/**
+	 * Returns the number of packets other analyzers have forwarded to
+	 * this one.
+	 */
+	uint64_t PacketsProcessed() const	{ return num_packets_processed; }
+
 	/**
 	 * Analyzes the given packet. A common case is that the analyzed protocol
 	 * encapsulates another protocol, which can be determined by an identifier
@@ -173,6 +179,8 @@ private:
 	 */
 	bool report_unknown_protocols = true;
 
+	uint64_t num_packets_processed = 0;
+
 	void Init(const Tag& tag);
 };
 
@@ -66,6 +66,11 @@ public:
 	 */
 	AnalyzerPtr GetAnalyzer(const std::string& name);
 
+	/**
+	 * Returns all analyzer instances, keyed by name.
+	 */
+	const std::map<std::string, AnalyzerPtr>& GetAnalyzers() const	{ return analyzers; }
+
 	/**
 	 * Processes a packet by applying the configured packet analyzers.
 	 *
@@ -5,6 +5,7 @@
 #include "zeek/IP.h"
 #include "zeek/Discard.h"
 #include "zeek/PacketFilter.h"
+#include "zeek/ShuntTable.h"
 #include "zeek/session/Manager.h"
 #include "zeek/RunState.h"
 #include "zeek/Frag.h"
@@ -18,11 +19,6 @@ IPAnalyzer::IPAnalyzer()
 	: zeek::packet_analysis::Analyzer("IP")
 	{
 	discarder = new detail::Discarder();
-	if ( ! discarder->IsActive() )
-		{
-		delete discarder;
-		discarder = nullptr;
-		}
 	}
 
 IPAnalyzer::~IPAnalyzer()
@@ -122,6 +118,12 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 			}
 		}
 
+	// Drop packets of flows that have been shunted. Doing this first
+	// saves them the checksum verification and filtering as well.
+	// Fragments get checked once they have been reassembled, below.
+	if ( detail::shunt_table->NextPacket(packet->ip_hdr, total_len, len) )
+		return false;
+
 	// Ignore if packet matches packet filter.
 	detail::PacketFilter* packet_filter = packet_mgr->GetPacketFilter(false);
 	if ( packet_filter && packet_filter->Match(packet->ip_hdr, total_len, len) )
@@ -135,7 +137,7 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 		return false;
 		}
 
-	if ( discarder && discarder->NextPacket(packet->ip_hdr, total_len, len) )
+	if ( discarder->IsActive() && discarder->NextPacket(packet->ip_hdr, total_len, len) )
 		return false;
 
 	detail::FragReassembler* f = nullptr;
@@ -184,6 +186,9 @@ bool IPAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* packet)
 
 	detail::FragReassemblerTracker frt(f);
 
+	if ( f && detail::shunt_table->NextPacket(packet->ip_hdr, total_len, len) )
+		return false;
+
 	// We stop building the chain when seeing IPPROTO_ESP so if it's
 	// there, it's always the last.
 	if ( packet->ip_hdr->LastHeader() == IPPROTO_ESP )
@@ -192,20 +192,20 @@ void IPBasedAnalyzer::BuildSessionAnalyzerTree(Connection* conn)
 		if ( ! analyzers_by_port.empty() && ! zeek::detail::dpd_ignore_ports )
 			{
 			int resp_port = ntohs(conn->RespPort());
-			std::set<analyzer::Tag>* ports = LookupPort(resp_port, false);
+			PortAnalyzers* ports = LookupPort(resp_port, false);
 
 			if ( ports )
 				{
-				for ( const auto& port : *ports )
+				for ( const auto* c : ports->components )
 					{
-					analyzer::Analyzer* analyzer = analyzer_mgr->InstantiateAnalyzer(port, conn);
+					analyzer::Analyzer* analyzer = analyzer_mgr->InstantiateAnalyzer(c, conn);
 
 					if ( ! analyzer )
 						continue;
 
 					root->AddChildAnalyzer(analyzer, false);
 					DBG_ANALYZER_ARGS(conn, "activated %s analyzer due to port %d",
-					                  analyzer_mgr->GetComponentName(port).c_str(), resp_port);
+					                  c->CanonicalName().c_str(), resp_port);
 					}
 				}
 			}
@@ -225,7 +225,7 @@ void IPBasedAnalyzer::BuildSessionAnalyzerTree(Connection* conn)
 
 bool IPBasedAnalyzer::RegisterAnalyzerForPort(const analyzer::Tag& tag, uint32_t port)
 	{
-	tag_set* l = LookupPort(port, true);
+	PortAnalyzers* l = LookupPort(port, true);
 
 	if ( ! l )
 		return false;
@@ -235,13 +235,14 @@ bool IPBasedAnalyzer::RegisterAnalyzerForPort(const analyzer::Tag& tag, uint32_t
 	DBG_LOG(DBG_ANALYZER, "Registering analyzer %s for port %" PRIu32 "/%d", name, port, transport);
 #endif
 
-	l->insert(tag);
+	l->tags.insert(tag);
+	UpdatePortComponents(l);
 	return true;
 	}
 
 bool IPBasedAnalyzer::UnregisterAnalyzerForPort(const analyzer::Tag& tag, uint32_t port)
 	{
-	tag_set* l = LookupPort(port, true);
+	PortAnalyzers* l = LookupPort(port, true);
 
 	if ( ! l )
 		return true;  // still a "successful" unregistration
@@ -251,11 +252,12 @@ bool IPBasedAnalyzer::UnregisterAnalyzerForPort(const analyzer::Tag& tag, uint32
 	DBG_LOG(DBG_ANALYZER, "Unregistering analyzer %s for port %" PRIu32 "/%d", name, port, transport);
 #endif
 
-	l->erase(tag);
+	l->tags.erase(tag);
+	UpdatePortComponents(l);
 	return true;
 	}
 
-IPBasedAnalyzer::tag_set* IPBasedAnalyzer::LookupPort(uint32_t port, bool add_if_not_found)
+IPBasedAnalyzer::PortAnalyzers* IPBasedAnalyzer::LookupPort(uint32_t port, bool add_if_not_found)
 	{
 	analyzer_map_by_port::const_iterator i = analyzers_by_port.find(port);
 
@@ -265,18 +267,30 @@ IPBasedAnalyzer::tag_set* IPBasedAnalyzer::LookupPort(uint32_t port, bool add_if
 	if ( ! add_if_not_found )
 		return nullptr;
 
-	tag_set* l = new tag_set{};
+	PortAnalyzers* l = new PortAnalyzers{};
 	analyzers_by_port.insert(std::make_pair(port, l));
 	return l;
 	}
 
+void IPBasedAnalyzer::UpdatePortComponents(PortAnalyzers* p)
+	{
+	p->components.clear();
+
+	// Unknown tags stay in as null, so that instantiating them reports
+	// them for each connection as before.
+	for ( const auto& tag : p->tags )
+		p->components.push_back(analyzer_mgr->Lookup(tag));
+	}
+
 void IPBasedAnalyzer::DumpPortDebug()
 	{
-	for ( const auto& mapping : analyzers_by_port )
+	std::map<uint32_t, PortAnalyzers*> sorted(analyzers_by_port.begin(), analyzers_by_port.end());
+
+	for ( const auto& mapping : sorted )
 		{
 		std::string s;
 
-		for ( const auto& tag : *(mapping.second) )
+		for ( const auto& tag : mapping.second->tags )
 			s += std::string(analyzer_mgr->GetComponentName(tag)) + " ";
 
 		DBG_LOG(DBG_ANALYZER, "    %d/%s: %s", mapping.first, transport_proto_string(transport), s.c_str());
@@ -4,6 +4,8 @@
 
 #include <map>
 #include <set>
+#include <unordered_map>
+#include <vector>
 
 #include "zeek/packet_analysis/Analyzer.h"
 #include "zeek/analyzer/Tag.h"
@@ -158,10 +160,20 @@ private:
 	// are persitent objects. We can't do this in the adapters because those get created
 	// and destroyed for each connection.
 	using tag_set = std::set<analyzer::Tag>;
-	using analyzer_map_by_port = std::map<uint32_t, tag_set*>;
+
+	// The analyzers registered for a port. Their components get looked up
+	// whenever the set changes, so that building the analyzer tree for a
+	// new connection can go straight to the factories.
+	struct PortAnalyzers {
+		tag_set tags;
+		std::vector<const analyzer::Component*> components; // Null if unknown.
+	};
+
+	using analyzer_map_by_port = std::unordered_map<uint32_t, PortAnalyzers*>;
 	analyzer_map_by_port analyzers_by_port;
 
-	tag_set* LookupPort(uint32_t port, bool add_if_not_found);
+	PortAnalyzers* LookupPort(uint32_t port, bool add_if_not_found);
+	void UpdatePortComponents(PortAnalyzers* p);
 
 	/**
 	 * Creates a new Connection object from data gleaned from the current packet.
@@ -4,14 +4,31 @@
 
 #include <math.h>
 #include <stdint.h>
+#include <algorithm>
+#include <array>
 #include <utility>
 
 #include <broker/data.hh>
 
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/Reporter.h"
 
 namespace zeek::probabilistic::detail {
 
+// Registers hold ranks of 64-bit hashes, so they never exceed 64.
+static constexpr int MAX_RANK = 64;
+
+// 2^-r for every possible register value r.
+static const std::array<double, MAX_RANK + 1> inverse_powers = []
+	{
+	std::array<double, MAX_RANK + 1> a{};
+
+	for ( int i = 0; i <= MAX_RANK; i++ )
+		a[i] = ldexp(1.0, -i);
+
+	return a;
+	}();
+
 int CardinalityCounter::OptimalB(double error, double confidence) const
 	{
 	double initial_estimate = 2 * (log(1.04) - log(error)) / log(2);
@@ -151,9 +168,20 @@ void CardinalityCounter::AddElement(uint64_t hash)
  **/
 double CardinalityCounter::Size() const
 	{
+	// Build a histogram of register values first. That's a tight integer
+	// loop over the registers, leaving only MAX_RANK + 1 floating-point
+	// terms for the harmonic sum. Adding those up in this order rather
+	// than register by register can change the last bits of the
+	// estimate.
+	std::array<uint64_t, MAX_RANK + 1> histogram{};
+	const uint8_t* r = buckets.data();
+
+	for ( uint64_t i = 0; i < m; i++ )
+		++histogram[std::min<int>(r[i], MAX_RANK)];
+
 	double answer = 0;
-	for ( unsigned int i = 0; i < m; i++ )
-		answer += pow(2, -((int)buckets[i]));
+	for ( int i = MAX_RANK; i >= 0; i-- )
+		answer += histogram[i] * inverse_powers[i];
 
 	answer = 1 / answer;
 	answer = (alpha_m * m * m * answer);
@@ -173,18 +201,15 @@ bool CardinalityCounter::Merge(CardinalityCounter* c)
 	if ( m != c->GetM() )
 		return false;
 
-	const std::vector<uint8_t>& temp = c->GetBuckets();
-
-	V = 0;
+	const uint8_t* src = c->GetBuckets().data();
+	uint8_t* dst = buckets.data();
 
+	// Kept free of branches and cross-iteration dependencies so that the
+	// compiler turns both loops into vector instructions.
 	for ( size_t i = 0; i < m; i++ )
-		{
-		if ( temp[i] > buckets[i] )
-			buckets[i] = temp[i];
+		dst[i] = std::max(dst[i], src[i]);
 
-		if ( buckets[i] == 0 )
-			++V;
-		}
+	V = std::count(dst, dst + m, 0);
 
 	return true;
 	}
@@ -199,9 +224,64 @@ uint64_t CardinalityCounter::GetM() const
 	return m;
 	}
 
+// Appends an unsigned LEB128 encoding of a value.
+static void append_varint(std::string& s, uint64_t v)
+	{
+	while ( v >= 0x80 )
+		{
+		s.push_back(static_cast<char>((v & 0x7f) | 0x80));
+		v >>= 7;
+		}
+
+	s.push_back(static_cast<char>(v));
+	}
+
+// Decodes an unsigned LEB128 value, returning false on truncated input.
+static bool read_varint(const std::string& s, size_t* pos, uint64_t* v)
+	{
+	*v = 0;
+
+	for ( int shift = 0; shift < 64 && *pos < s.size(); shift += 7 )
+		{
+		auto byte = static_cast<uint8_t>(s[(*pos)++]);
+		*v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+		if ( ! (byte & 0x80) )
+			return true;
+		}
+
+	return false;
+	}
+
 broker::expected<broker::data> CardinalityCounter::Serialize() const
 	{
 	broker::vector v = {m, V, alpha_m};
+
+	// Counters that have seen few elements have mostly empty registers.
+	// For those, send only the non-empty ones as a string of (index delta,
+	// value) pairs instead of one broker value per register.
+	uint64_t used = m - V;
+
+	if ( used * 4 < m )
+		{
+		std::string sparse;
+		sparse.reserve(used * 3);
+		uint64_t last = 0;
+
+		for ( uint64_t i = 0; i < m; ++i )
+			{
+			if ( buckets[i] == 0 )
+				continue;
+
+			append_varint(sparse, i - last);
+			sparse.push_back(static_cast<char>(buckets[i]));
+			last = i;
+			}
+
+		v.emplace_back(std::move(sparse));
+		return {std::move(v)};
+		}
+
 	v.reserve(3 + m);
 
 	for ( size_t i = 0; i < m; ++i )
@@ -222,7 +302,10 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 
 	if ( ! (m && V && alpha_m) )
 		return nullptr;
-	if ( v->size() != 3 + *m )
+
+	auto sparse = v->size() == 4 ? caf::get_if<std::string>(&(*v)[3]) : nullptr;
+
+	if ( ! sparse && v->size() != 3 + *m )
 		return nullptr;
 
 	auto cc = std::unique_ptr<CardinalityCounter>(new CardinalityCounter(*m, *V, *alpha_m));
@@ -231,6 +314,30 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 	if ( cc->buckets.size() != * m )
 		return nullptr;
 
+	if ( sparse )
+		{
+		size_t pos = 0;
+		uint64_t idx = 0;
+
+		while ( pos < sparse->size() )
+			{
+			uint64_t delta;
+
+			if ( ! read_varint(*sparse, &pos, &delta) || pos >= sparse->size() )
+				return nullptr;
+
+			idx += delta;
+			auto x = static_cast<uint8_t>((*sparse)[pos++]);
+
+			if ( idx >= *m || x > MAX_RANK )
+				return nullptr;
+
+			cc->buckets[idx] = x;
+			}
+
+		return cc;
+		}
+
 	for ( size_t i = 0; i < *m; ++i )
 		{
 		auto x = caf::get_if<uint64_t>(&(*v)[3 + i]);
@@ -243,6 +350,54 @@ std::unique_ptr<CardinalityCounter> CardinalityCounter::Unserialize(const broker
 	return cc;
 	}
 
+TEST_SUITE_BEGIN("CardinalityCounter");
+
+TEST_CASE("cardinality counter sparse serialization")
+	{
+	CardinalityCounter c(static_cast<uint64_t>(1024));
+
+	for ( uint64_t i = 0; i < 50; i++ )
+		c.AddElement(i * 0x9e3779b97f4a7c15ULL);
+
+	auto d = c.Serialize();
+	REQUIRE(d);
+	auto v = caf::get_if<broker::vector>(&*d);
+	REQUIRE(v);
+	CHECK(v->size() == 4);
+
+	auto u = CardinalityCounter::Unserialize(*d);
+	REQUIRE(u);
+	CHECK(u->Size() == c.Size());
+	}
+
+TEST_CASE("cardinality counter dense serialization and merge")
+	{
+	CardinalityCounter c1(static_cast<uint64_t>(64));
+	CardinalityCounter c2(static_cast<uint64_t>(64));
+
+	for ( uint64_t i = 0; i < 1000; i++ )
+		{
+		c1.AddElement(i * 0x9e3779b97f4a7c15ULL);
+		c2.AddElement((i + 500) * 0x9e3779b97f4a7c15ULL);
+		}
+
+	auto d = c1.Serialize();
+	REQUIRE(d);
+	auto v = caf::get_if<broker::vector>(&*d);
+	REQUIRE(v);
+	CHECK(v->size() == 3 + 64);
+
+	auto u = CardinalityCounter::Unserialize(*d);
+	REQUIRE(u);
+	CHECK(u->Size() == c1.Size());
+
+	double before = c1.Size();
+	CHECK(c1.Merge(&c2));
+	CHECK(c1.Size() >= before);
+	}
+
+TEST_SUITE_END();
+
 /**
  * The following function is copied from libc/string/flsll.c from the FreeBSD source
  * tree. Original copyright message follows
@@ -89,6 +89,10 @@ public:
 	 */
 	bool Merge(CardinalityCounter* c);
 
+	/**
+	 * Serializes the counter. Counters with mostly empty registers are
+	 * encoded sparsely, listing only the registers that are in use.
+	 */
 	broker::expected<broker::data> Serialize() const;
 	static std::unique_ptr<CardinalityCounter> Unserialize(const broker::data& data);
 
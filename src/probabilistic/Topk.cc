@@ -7,16 +7,9 @@
 #include "zeek/broker/Data.h"
 #include "zeek/CompHash.h"
 #include "zeek/Reporter.h"
-#include "zeek/Dict.h"
 
 namespace zeek::probabilistic::detail {
 
-static void topk_element_hash_delete_func(void* val)
-	{
-	Element* e = (Element*) val;
-	delete e;
-	}
-
 void TopkVal::Typify(TypePtr t)
 	{
 	assert(!hash && !type);
@@ -26,17 +19,16 @@ void TopkVal::Typify(TypePtr t)
 	hash = new zeek::detail::CompositeHash(std::move(tl));
 	}
 
-zeek::detail::HashKey* TopkVal::GetHash(Val* v) const
+std::string TopkVal::GetHash(const Val* v) const
 	{
 	auto key = hash->MakeHashKey(*v, true);
 	assert(key);
-	return key.release();
+	return std::string(static_cast<const char*>(key->Key()), key->Size());
 	}
 
 TopkVal::TopkVal(uint64_t arg_size) : OpaqueVal(topk_type)
 	{
-	elementDict = new PDict<Element>;
-	elementDict->SetDeleteFunc(topk_element_hash_delete_func);
+	first_bucket = last_bucket = TOPK_NIL;
 	size = arg_size;
 	numElements = 0;
 	pruned = false;
@@ -45,27 +37,134 @@ TopkVal::TopkVal(uint64_t arg_size) : OpaqueVal(topk_type)
 
 TopkVal::TopkVal() : OpaqueVal(topk_type)
 	{
-	elementDict = new PDict<Element>;
-	elementDict->SetDeleteFunc(topk_element_hash_delete_func);
+	first_bucket = last_bucket = TOPK_NIL;
 	size = 0;
 	numElements = 0;
+	pruned = false;
 	hash = nullptr;
 	}
 
 TopkVal::~TopkVal()
 	{
-	elementDict->Clear();
-	delete elementDict;
+	delete hash;
+	}
+
+uint32_t TopkVal::NewBucket(uint64_t count, uint32_t before)
+	{
+	uint32_t b;
 
-	// now all elements are already gone - delete the buckets
-	std::list<Bucket*>::iterator bi = buckets.begin();
-	while ( bi != buckets.end() )
+	if ( free_buckets.empty() )
+		{
+		b = buckets.size();
+		buckets.emplace_back();
+		}
+	else
 		{
-		delete *bi;
-		bi++;
+		b = free_buckets.back();
+		free_buckets.pop_back();
 		}
 
-	delete hash;
+	Bucket& bucket = buckets[b];
+	bucket.count = count;
+	bucket.size = 0;
+	bucket.head = bucket.tail = TOPK_NIL;
+	bucket.next = before;
+	bucket.prev = ( before == TOPK_NIL ) ? last_bucket : buckets[before].prev;
+
+	if ( bucket.prev == TOPK_NIL )
+		first_bucket = b;
+	else
+		buckets[bucket.prev].next = b;
+
+	if ( before == TOPK_NIL )
+		last_bucket = b;
+	else
+		buckets[before].prev = b;
+
+	return b;
+	}
+
+void TopkVal::FreeBucket(uint32_t b)
+	{
+	Bucket& bucket = buckets[b];
+	assert(bucket.size == 0);
+
+	if ( bucket.prev == TOPK_NIL )
+		first_bucket = bucket.next;
+	else
+		buckets[bucket.prev].next = bucket.next;
+
+	if ( bucket.next == TOPK_NIL )
+		last_bucket = bucket.prev;
+	else
+		buckets[bucket.next].prev = bucket.prev;
+
+	free_buckets.push_back(b);
+	}
+
+uint32_t TopkVal::NewElement(ValPtr value, uint64_t epsilon)
+	{
+	uint32_t e;
+
+	if ( free_elements.empty() )
+		{
+		e = elements.size();
+		elements.emplace_back();
+		}
+	else
+		{
+		e = free_elements.back();
+		free_elements.pop_back();
+		}
+
+	Element& element = elements[e];
+	element.epsilon = epsilon;
+	element.value = std::move(value);
+	element.parent = element.prev = element.next = TOPK_NIL;
+	return e;
+	}
+
+void TopkVal::FreeElement(uint32_t e)
+	{
+	elements[e].value = nullptr;
+	free_elements.push_back(e);
+	}
+
+void TopkVal::LinkElement(uint32_t b, uint32_t e)
+	{
+	Bucket& bucket = buckets[b];
+	Element& element = elements[e];
+
+	element.parent = b;
+	element.prev = bucket.tail;
+	element.next = TOPK_NIL;
+
+	if ( bucket.tail == TOPK_NIL )
+		bucket.head = e;
+	else
+		elements[bucket.tail].next = e;
+
+	bucket.tail = e;
+	bucket.size++;
+	}
+
+void TopkVal::UnlinkElement(uint32_t e)
+	{
+	Element& element = elements[e];
+	Bucket& bucket = buckets[element.parent];
+
+	if ( element.prev == TOPK_NIL )
+		bucket.head = element.next;
+	else
+		elements[element.prev].next = element.next;
+
+	if ( element.next == TOPK_NIL )
+		bucket.tail = element.prev;
+	else
+		elements[element.next].prev = element.prev;
+
+	bucket.size--;
+	element.parent = element.prev = element.next = TOPK_NIL;
 	}
 
 void TopkVal::Merge(const TopkVal* value, bool doPrune)
@@ -92,54 +191,49 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 			}
 		}
 
-	std::list<Bucket*>::const_iterator it = value->buckets.begin();
-	while ( it != value->buckets.end() )
+	elements.reserve(elements.size() + value->numElements);
+
+	for ( uint32_t b = value->first_bucket; b != TOPK_NIL; b = value->buckets[b].next )
 		{
-		Bucket* b = *it;
-		uint64_t currcount = b->count;
-		std::list<Element*>::const_iterator eit = b->elements.begin();
+		uint64_t currcount = value->buckets[b].count;
 
-		while ( eit != b->elements.end() )
+		for ( uint32_t e = value->buckets[b].head; e != TOPK_NIL; e = value->elements[e].next )
 			{
-			Element* e = *eit;
+			// Copy what we need, as adding elements may move our own
+			// storage around.
+			ValPtr other_value = value->elements[e].value;
+			uint64_t other_epsilon = value->elements[e].epsilon;
+
 			// lookup if we already know this one...
-			zeek::detail::HashKey* key = GetHash(e->value);
-			Element* olde = (Element*) elementDict->Lookup(key);
+			auto key = GetHash(other_value);
+			auto it = elementIndex.find(key);
+			uint32_t olde;
 
-			if ( olde == nullptr )
+			if ( it == elementIndex.end() )
 				{
-				olde = new Element();
-				olde->epsilon = 0;
-				olde->value = e->value;
+				olde = NewElement(other_value, 0);
+
 				// insert at bucket position 0
-				if ( buckets.size() > 0 )
+				if ( first_bucket != TOPK_NIL )
 					{
-					assert (buckets.front()-> count > 0 );
+					assert(buckets[first_bucket].count > 0);
 					}
 
-				Bucket* newbucket = new Bucket();
-				newbucket->count = 0;
-				newbucket->bucketPos = buckets.insert(buckets.begin(), newbucket);
-
-				olde->parent = newbucket;
-				newbucket->elements.insert(newbucket->elements.end(), olde);
+				uint32_t newbucket = NewBucket(0, first_bucket);
+				LinkElement(newbucket, olde);
 
-				elementDict->Insert(key, olde);
+				elementIndex.emplace(std::move(key), olde);
 				numElements++;
-
 				}
+			else
+				olde = it->second;
 
 			// now that we are sure that the old element is present - increment epsilon
-			olde->epsilon += e->epsilon;
+			elements[olde].epsilon += other_epsilon;
 
 			// and increment position...
 			IncrementCounter(olde, currcount);
-			delete key;
-
-			eit++;
 			}
-
-		it++;
 		}
 
 	// now we have added everything. And our top-k table could be too big.
@@ -153,23 +247,17 @@ void TopkVal::Merge(const TopkVal* value, bool doPrune)
 	while ( numElements > size )
 		{
 		pruned = true;
-		assert(buckets.size() > 0 );
-		Bucket* b = buckets.front();
-		assert(b->elements.size() > 0);
-
-		Element* e = b->elements.front();
-		zeek::detail::HashKey* key = GetHash(e->value);
-		elementDict->RemoveEntry(key);
-		delete key;
-		delete e;
+		assert(first_bucket != TOPK_NIL);
+		uint32_t b = first_bucket;
+		assert(buckets[b].size > 0);
 
-		b->elements.pop_front();
+		uint32_t e = buckets[b].head;
+		elementIndex.erase(GetHash(elements[e].value));
+		UnlinkElement(e);
+		FreeElement(e);
 
-		if ( b->elements.size() == 0 )
-			{
-			delete b;
-			buckets.pop_front();
-			}
+		if ( buckets[b].size == 0 )
+			FreeBucket(b);
 
 		numElements--;
 		}
@@ -197,24 +285,14 @@ VectorValPtr TopkVal::GetTopK(int k) const // returns vector
 	// in any case - just to make this future-proof (and I am lazy) - this can return more than k.
 
 	int read = 0;
-	std::list<Bucket*>::const_iterator it = buckets.end();
-	it--;
-	while (read < k )
+
+	for ( uint32_t b = last_bucket; b != TOPK_NIL && read < k; b = buckets[b].prev )
 		{
-		//printf("Bucket %llu\n", (*it)->count);
-		std::list<Element*>::iterator eit = (*it)->elements.begin();
-		while ( eit != (*it)->elements.end() )
+		for ( uint32_t e = buckets[b].head; e != TOPK_NIL; e = elements[e].next )
 			{
-			//printf("Size: %ld\n", (*it)->elements.size());
-			t->Assign(read, (*eit)->value);
+			t->Assign(read, elements[e].value);
 			read++;
-			eit++;
 			}
-
-		if ( it == buckets.begin() )
-			break;
-
-		it--;
 		}
 
 	return t;
@@ -222,45 +300,36 @@ VectorValPtr TopkVal::GetTopK(int k) const // returns vector
 
 uint64_t TopkVal::GetCount(Val* value) const
 	{
-	zeek::detail::HashKey* key = GetHash(value);
-	Element* e = (Element*) elementDict->Lookup(key);
-	delete key;
+	auto it = elementIndex.find(GetHash(value));
 
-	if ( e == nullptr )
+	if ( it == elementIndex.end() )
 		{
 		reporter->Error("GetCount for element that is not in top-k");
 		return 0;
 		}
 
-	return e->parent->count;
+	return buckets[elements[it->second].parent].count;
 	}
 
 uint64_t TopkVal::GetEpsilon(Val* value) const
 	{
-	zeek::detail::HashKey* key = GetHash(value);
-	Element* e = (Element*) elementDict->Lookup(key);
-	delete key;
+	auto it = elementIndex.find(GetHash(value));
 
-	if ( e == nullptr )
+	if ( it == elementIndex.end() )
 		{
 		reporter->Error("GetEpsilon for element that is not in top-k");
 		return 0;
 		}
 
-	return e->epsilon;
+	return elements[it->second].epsilon;
 	}
 
 uint64_t TopkVal::GetSum() const
 	{
 	uint64_t sum = 0;
 
-	std::list<Bucket*>::const_iterator it = buckets.begin();
-	while ( it != buckets.end() )
-		{
-		sum += (*it)->elements.size() * (*it)->count;
-
-		it++;
-		}
+	for ( uint32_t b = first_bucket; b != TOPK_NIL; b = buckets[b].next )
+		sum += buckets[b].size * buckets[b].count;
 
 	if ( pruned )
 		reporter->Warning("TopkVal::GetSum() was used on a pruned data structure. Result values do not represent total element count");
@@ -282,39 +351,27 @@ void TopkVal::Encountered(ValPtr encountered)
 			}
 
 	// Step 1 - get the hash.
-	zeek::detail::HashKey* key = GetHash(encountered);
-	Element* e = (Element*) elementDict->Lookup(key);
+	auto key = GetHash(encountered);
+	auto it = elementIndex.find(key);
+	uint32_t e;
 
-	if ( e == nullptr )
+	if ( it == elementIndex.end() )
 		{
-		e = new Element();
-		e->epsilon = 0;
-		e->value = std::move(encountered);
-
 		// well, we do not know this one yet...
 		if ( numElements < size )
 			{
 			// brilliant. just add it at position 1
-			if ( buckets.size() == 0 || (*buckets.begin())->count > 1 )
-				{
-				Bucket* b = new Bucket();
-				b->count = 1;
-				std::list<Bucket*>::iterator pos = buckets.insert(buckets.begin(), b);
-				b->bucketPos = pos;
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
-				}
-			else
-				{
-				Bucket* b = *buckets.begin();
-				assert(b->count == 1);
-				b->elements.insert(b->elements.end(), e);
-				e->parent = b;
-				}
+			uint32_t b = first_bucket;
 
-			elementDict->Insert(key, e);
+			if ( b == TOPK_NIL || buckets[b].count > 1 )
+				b = NewBucket(1, first_bucket);
+
+			assert(buckets[b].count == 1);
+			e = NewElement(std::move(encountered), 0);
+			LinkElement(b, e);
+
+			elementIndex.emplace(std::move(key), e);
 			numElements++;
-			delete key;
 
 			return; // done. it is at pos 1.
 			}
@@ -322,79 +379,61 @@ void TopkVal::Encountered(ValPtr encountered)
 		else
 			{
 			// replace element with min-value
-			Bucket* b = *buckets.begin(); // bucket with smallest elements
+			uint32_t b = first_bucket; // bucket with smallest elements
 
 			// evict oldest element with least hits.
-			assert(b->elements.size() > 0);
-			zeek::detail::HashKey* deleteKey = GetHash((*(b->elements.begin()))->value);
-			b->elements.erase(b->elements.begin());
-			Element* deleteElement = (Element*) elementDict->RemoveEntry(deleteKey);
-			assert(deleteElement); // there has to have been a minimal element...
-			delete deleteElement;
-			delete deleteKey;
+			assert(buckets[b].size > 0);
+			uint32_t deleteElement = buckets[b].head;
+			auto erased = elementIndex.erase(GetHash(elements[deleteElement].value));
+			assert(erased); // there has to have been a minimal element...
+			(void) erased;
+			UnlinkElement(deleteElement);
+			FreeElement(deleteElement);
 
 			// and add the new one to the end
-			e->epsilon = b->count;
-			b->elements.insert(b->elements.end(), e);
-			elementDict->Insert(key, e);
-			e->parent = b;
+			e = NewElement(std::move(encountered), buckets[b].count);
+			LinkElement(b, e);
+			elementIndex.emplace(std::move(key), e);
 
 			// fallthrough, increment operation has to run!
 			}
 
 		}
+	else
+		e = it->second;
 
 	// ok, we now have an element in e
-	delete key;
 	IncrementCounter(e); // well, this certainly was anticlimatic.
 	}
 
 // increment by count
-void TopkVal::IncrementCounter(Element* e, unsigned int count)
+void TopkVal::IncrementCounter(uint32_t e, uint64_t count)
 	{
-	Bucket* currBucket = e->parent;
-	uint64_t currcount = currBucket->count;
+	uint32_t currBucket = elements[e].parent;
+	uint64_t currcount = buckets[currBucket].count;
 
 	// well, let's test if there is a bucket for currcount++
-	std::list<Bucket*>::iterator bucketIter = currBucket->bucketPos;
+	uint32_t bucketIter = buckets[currBucket].next;
 
-	Bucket* nextBucket = nullptr;
+	while ( bucketIter != TOPK_NIL && buckets[bucketIter].count < currcount+count )
+		bucketIter = buckets[bucketIter].next;
 
-	bucketIter++;
+	uint32_t nextBucket;
 
-	while ( bucketIter != buckets.end() && (*bucketIter)->count < currcount+count )
-		bucketIter++;
-
-	if ( bucketIter != buckets.end() && (*bucketIter)->count == currcount+count )
-		nextBucket = *bucketIter;
-
-	if ( nextBucket == nullptr )
-		{
+	if ( bucketIter != TOPK_NIL && buckets[bucketIter].count == currcount+count )
+		nextBucket = bucketIter;
+	else
 		// the bucket for the value that we want does not exist.
 		// create it...
-
-		Bucket* b = new Bucket();
-		b->count = currcount+count;
-
-		std::list<Bucket*>::iterator nextBucketPos = buckets.insert(bucketIter, b);
-		b->bucketPos = nextBucketPos; // and give it the iterator we know now.
-
-		nextBucket = b;
-		}
+		nextBucket = NewBucket(currcount+count, bucketIter);
 
 	// ok, now we have the new bucket in nextBucket. Shift the element over...
-	currBucket->elements.remove(e);
-	nextBucket->elements.insert(nextBucket->elements.end(), e);
-
-	e->parent = nextBucket;
+	UnlinkElement(e);
+	LinkElement(nextBucket, e);
 
 	// if currBucket is empty, we have to delete it now
-	if ( currBucket->elements.size() == 0 )
-		{
-		buckets.remove(currBucket);
-		delete currBucket;
-		currBucket = nullptr;
-		}
+	if ( buckets[currBucket].size == 0 )
+		FreeBucket(currBucket);
 	}
 
 IMPLEMENT_OPAQUE_VALUE(TopkVal)
@@ -414,32 +453,25 @@ broker::expected<broker::data> TopkVal::DoSerialize() const
 	else
 		d.emplace_back(broker::none());
 
+	d.reserve(d.size() + 2 * (buckets.size() - free_buckets.size()) + 2 * numElements);
+
 	uint64_t i = 0;
-	std::list<Bucket*>::const_iterator it = buckets.begin();
-	while ( it != buckets.end() )
-		{
-		Bucket* b = *it;
-		uint32_t elements_count = b->elements.size();
 
-		d.emplace_back(static_cast<uint64_t>(b->elements.size()));
-		d.emplace_back(b->count);
+	for ( uint32_t b = first_bucket; b != TOPK_NIL; b = buckets[b].next )
+		{
+		d.emplace_back(static_cast<uint64_t>(buckets[b].size));
+		d.emplace_back(buckets[b].count);
 
-		std::list<Element*>::const_iterator eit = b->elements.begin();
-		while ( eit != b->elements.end() )
+		for ( uint32_t e = buckets[b].head; e != TOPK_NIL; e = elements[e].next )
 			{
-			Element* element = *eit;
-			d.emplace_back(element->epsilon);
-			auto v = Broker::detail::val_to_data(element->value.get());
+			d.emplace_back(elements[e].epsilon);
+			auto v = Broker::detail::val_to_data(elements[e].value.get());
 			if ( ! v )
 				return broker::ec::invalid_data;
 
-			d.emplace_back(*v);
-
-			eit++;
+			d.emplace_back(std::move(*v));
 			i++;
 			}
-
-		it++;
 		}
 
 	assert(i == numElements);
@@ -479,17 +511,26 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 	uint64_t i = 0;
 	uint64_t idx = 4;
 
+	if ( (v->size() - idx) / 2 < numElements )
+		return false;
+
+	elements.reserve(numElements);
+
 	while ( i < numElements )
 		{
+		if ( idx + 2 > v->size() )
+			return false;
+
 		auto elements_count = caf::get_if<uint64_t>(&(*v)[idx++]);
 		auto count = caf::get_if<uint64_t>(&(*v)[idx++]);
 
 		if ( ! (elements_count && count) )
 			return false;
 
-		Bucket* b = new Bucket();
-		b->count = *count;
-		b->bucketPos = buckets.insert(buckets.end(), b);
+		if ( idx + 2 * *elements_count > v->size() )
+			return false;
+
+		uint32_t b = NewBucket(*count, TOPK_NIL);
 
 		for ( uint64_t j = 0; j < *elements_count; j++ )
 			{
@@ -499,18 +540,12 @@ bool TopkVal::DoUnserialize(const broker::data& data)
 			if ( ! (epsilon && val) )
 				return false;
 
-			Element* e = new Element();
-			e->epsilon = *epsilon;
-			e->value = std::move(val);
-			e->parent = b;
+			uint32_t e = NewElement(std::move(val), *epsilon);
+			LinkElement(b, e);
 
-			b->elements.insert(b->elements.end(), e);
-
-			zeek::detail::HashKey* key = GetHash(e->value);
-			assert (elementDict->Lookup(key) == nullptr);
-
-			elementDict->Insert(key, e);
-			delete key;
+			// Each value may appear only once.
+			if ( ! elementIndex.emplace(GetHash(elements[e].value), e).second )
+				return false;
 
 			i++;
 			}
@@ -2,33 +2,44 @@
 
 #pragma once
 
-#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include "zeek/Val.h"
 #include "zeek/OpaqueVal.h"
+#include "zeek/Hash.h"
 
 // This class implements the top-k algorithm. Or - to be more precise - an
 // interpretation of it.
+//
+// The stream-summary is kept in two flat arrays, one for buckets and one
+// for elements. Buckets form a doubly-linked list ordered by ascending
+// count and each bucket links the elements with that count, in insertion
+// order. All links are array indices, so updates don't allocate and walks
+// stay within contiguous memory.
 
 namespace zeek::detail { class CompositeHash; }
 
 namespace zeek::probabilistic::detail {
 
-struct Element;
+constexpr uint32_t TOPK_NIL = UINT32_MAX;
 
 struct Bucket {
 	uint64_t count;
-	std::list<Element*> elements;
-
-	// Iterators only get invalidated for removed elements. This one
-	// points to us - so it is invalid when we are no longer there. Cute,
-	// isn't it?
-	std::list<Bucket*>::iterator bucketPos;
+	uint32_t size; // number of elements in the bucket
+	uint32_t head; // first element, TOPK_NIL if empty
+	uint32_t tail; // last element, TOPK_NIL if empty
+	uint32_t prev; // bucket with the next-smaller count
+	uint32_t next; // bucket with the next-larger count
 };
 
 struct Element {
 	uint64_t epsilon;
 	ValPtr value;
-	Bucket* parent;
+	uint32_t parent; // index of the bucket containing the element
+	uint32_t prev; // previous element within the bucket
+	uint32_t next; // next element within the bucket
 };
 
 class TopkVal : public OpaqueVal {
@@ -139,21 +150,21 @@ private:
 	/**
 	 * Increment the counter for a specific element
 	 *
-	 * @param e element to increment counter for
+	 * @param e index of the element to increment counter for
 	 *
 	 * @param count increment counter by this much
 	 */
-	void IncrementCounter(Element* e, unsigned int count = 1);
+	void IncrementCounter(uint32_t e, uint64_t count = 1);
 
 	/**
-	 * get the hashkey for a specific value
+	 * get the hash index key for a specific value
 	 *
 	 * @param v value to generate key for
 	 *
-	 * @returns HashKey for value
+	 * @returns key for value
 	 */
-	zeek::detail::HashKey* GetHash(Val* v) const; // this probably should go somewhere else.
-	zeek::detail::HashKey* GetHash(const ValPtr& v) const
+	std::string GetHash(const Val* v) const; // this probably should go somewhere else.
+	std::string GetHash(const ValPtr& v) const
 		{ return GetHash(v.get()); }
 
 	/**
@@ -163,10 +174,56 @@ private:
 	 */
 	void Typify(TypePtr t);
 
+	/**
+	 * Allocate a bucket and link it into the bucket list.
+	 *
+	 * @param count count of the new bucket
+	 *
+	 * @param before index of the bucket to insert in front of, TOPK_NIL
+	 * to append to the list
+	 *
+	 * @returns index of the new bucket
+	 */
+	uint32_t NewBucket(uint64_t count, uint32_t before);
+
+	/**
+	 * Unlink an empty bucket from the bucket list and release it.
+	 */
+	void FreeBucket(uint32_t b);
+
+	/**
+	 * Allocate an element that isn't part of any bucket yet.
+	 *
+	 * @returns index of the new element
+	 */
+	uint32_t NewElement(ValPtr value, uint64_t epsilon);
+
+	/**
+	 * Release an element that has been unlinked from its bucket.
+	 */
+	void FreeElement(uint32_t e);
+
+	/**
+	 * Append an element to the end of a bucket.
+	 */
+	void LinkElement(uint32_t b, uint32_t e);
+
+	/**
+	 * Remove an element from its bucket. The bucket is left in place,
+	 * even if it becomes empty.
+	 */
+	void UnlinkElement(uint32_t e);
+
 	TypePtr type;
 	zeek::detail::CompositeHash* hash;
-	std::list<Bucket*> buckets;
-	PDict<Element>* elementDict;
+	std::vector<Bucket> buckets;
+	std::vector<uint32_t> free_buckets;
+	uint32_t first_bucket; // bucket with the smallest count
+	uint32_t last_bucket; // bucket with the largest count
+	std::vector<Element> elements;
+	std::vector<uint32_t> free_elements;
+	// Keyed by the values' hash keys. The values usually come from traffic.
+	std::unordered_map<std::string, uint32_t, zeek::detail::KeyedStringHash> elementIndex;
 	uint64_t size; // how many elements are we tracking?
 	uint64_t numElements; // how many elements do we have at the moment
 	bool pruned; // was this data structure pruned?
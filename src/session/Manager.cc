@@ -21,6 +21,7 @@
 #include "zeek/session/Session.h"
 #include "zeek/TunnelEncapsulation.h"
 #include "zeek/telemetry/Manager.h"
+#include "zeek/telemetry/Timer.h"
 #include "zeek/analyzer/Manager.h"
 
 #include "zeek/iosource/IOSource.h"
@@ -87,7 +88,13 @@ private:
 
 } // namespace detail
 
+static constexpr double lookup_latency_bounds[] = {
+	1e-7, 2.5e-7, 5e-7, 1e-6, 2.5e-6, 5e-6, 1e-5, 1e-4, 1e-3 };
+
 Manager::Manager()
+	: lookup_latency(telemetry_mgr->HistogramSingleton<double>(
+		  "zeek", "session-lookup-latency", lookup_latency_bounds,
+		  "Latency of a sample of connection table lookups", "seconds"))
 	{
 	stats = new detail::ProtocolStats();
 	}
@@ -151,6 +158,17 @@ Connection* Manager::FindConnection(Val* v)
 	}
 
 Connection* Manager::FindConnection(const zeek::detail::ConnKey& conn_key)
+	{
+	if ( zeek::detail::core_metrics && ++num_lookups % LOOKUP_SAMPLE_RATE == 0 )
+		{
+		telemetry::Timer t(lookup_latency);
+		return DoFindConnection(conn_key);
+		}
+
+	return DoFindConnection(conn_key);
+	}
+
+Connection* Manager::DoFindConnection(const zeek::detail::ConnKey& conn_key)
 	{
 	detail::Key key(&conn_key, sizeof(conn_key),
 	                detail::Key::CONNECTION_KEY_TYPE, false);
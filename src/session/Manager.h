@@ -128,8 +128,16 @@ private:
 	// avoid unnecessary incrementing of connecting counts).
 	void InsertSession(detail::Key key, Session* session);
 
+	Connection* DoFindConnection(const zeek::detail::ConnKey& conn_key);
+
 	SessionMap session_map;
 	detail::ProtocolStats* stats;
+
+	// Every LOOKUP_SAMPLE_RATE-th connection lookup gets timed for the
+	// session-lookup-latency histogram.
+	static constexpr uint64_t LOOKUP_SAMPLE_RATE = 64;
+	uint64_t num_lookups = 0;
+	telemetry::DblHistogram lookup_latency;
 };
 
 } // namespace session
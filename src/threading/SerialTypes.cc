@@ -185,6 +185,25 @@ bool Value::Read(detail::SerializationFormat* fmt)
 	if ( ! present )
 		return true;
 
+	return ReadContent(fmt, true);
+	}
+
+bool Value::ReadUntyped(detail::SerializationFormat* fmt, TypeTag arg_type, TypeTag arg_subtype)
+	{
+	type = arg_type;
+	subtype = arg_subtype;
+
+	if ( ! fmt->Read(&present, "present") )
+		return false;
+
+	if ( ! present )
+		return true;
+
+	return ReadContent(fmt, false);
+	}
+
+bool Value::ReadContent(detail::SerializationFormat* fmt, bool typed)
+	{
 	switch ( type ) {
 	case TYPE_BOOL:
 	case TYPE_INT:
@@ -282,13 +301,14 @@ bool Value::Read(detail::SerializationFormat* fmt)
 		if ( ! fmt->Read(&val.set_val.size, "set_size") )
 			return false;
 
-		val.set_val.vals = new Value* [val.set_val.size];
+		val.set_val.vals = new Value* [val.set_val.size]();
 
 		for ( bro_int_t i = 0; i < val.set_val.size; ++i )
 			{
-			val.set_val.vals[i] = new Value;
+			auto* v = new Value;
+			val.set_val.vals[i] = v;
 
-			if ( ! val.set_val.vals[i]->Read(fmt) )
+			if ( ! (typed ? v->Read(fmt) : v->ReadUntyped(fmt, subtype, TYPE_VOID)) )
 				return false;
 			}
 
@@ -300,13 +320,14 @@ bool Value::Read(detail::SerializationFormat* fmt)
 		if ( ! fmt->Read(&val.vector_val.size, "vector_size") )
 			return false;
 
-		val.vector_val.vals = new Value* [val.vector_val.size];
+		val.vector_val.vals = new Value* [val.vector_val.size]();
 
 		for ( bro_int_t i = 0; i < val.vector_val.size; ++i )
 			{
-			val.vector_val.vals[i] = new Value;
+			auto* v = new Value;
+			val.vector_val.vals[i] = v;
 
-			if ( ! val.vector_val.vals[i]->Read(fmt) )
+			if ( ! (typed ? v->Read(fmt) : v->ReadUntyped(fmt, subtype, TYPE_VOID)) )
 				return false;
 			}
 
@@ -330,6 +351,22 @@ bool Value::Write(detail::SerializationFormat* fmt) const
 	if ( ! present )
 		return true;
 
+	return WriteContent(fmt, true);
+	}
+
+bool Value::WriteUntyped(detail::SerializationFormat* fmt) const
+	{
+	if ( ! fmt->Write(present, "present") )
+		return false;
+
+	if ( ! present )
+		return true;
+
+	return WriteContent(fmt, false);
+	}
+
+bool Value::WriteContent(detail::SerializationFormat* fmt, bool typed) const
+	{
 	switch ( type ) {
 	case TYPE_BOOL:
 	case TYPE_INT:
@@ -394,7 +431,9 @@ bool Value::Write(detail::SerializationFormat* fmt) const
 
 		for ( int i = 0; i < val.set_val.size; ++i )
 			{
-			if ( ! val.set_val.vals[i]->Write(fmt) )
+			const auto* v = val.set_val.vals[i];
+
+			if ( ! (typed ? v->Write(fmt) : v->WriteUntyped(fmt)) )
 				return false;
 			}
 
@@ -408,7 +447,9 @@ bool Value::Write(detail::SerializationFormat* fmt) const
 
 		for ( int i = 0; i < val.vector_val.size; ++i )
 			{
-			if ( ! val.vector_val.vals[i]->Write(fmt) )
+			const auto* v = val.vector_val.vals[i];
+
+			if ( ! (typed ? v->Write(fmt) : v->WriteUntyped(fmt)) )
 				return false;
 			}
 
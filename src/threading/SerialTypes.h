@@ -199,6 +199,30 @@ struct Value {
 	 */
 	bool Write(zeek::detail::SerializationFormat* fmt) const;
 
+	/**
+	 * Unserializes a value written by WriteUntyped().
+	 *
+	 * @param fmt The serialization format to use. The format handles low-level I/O.
+	 *
+	 * @param type The type of the value.
+	 *
+	 * @param subtype The subtype of the value for sets and vectors.
+	 *
+	 * @return False if an error occured.
+	 */
+	bool ReadUntyped(zeek::detail::SerializationFormat* fmt, TypeTag type, TypeTag subtype);
+
+	/**
+	 * Serializes a value without its type information, which the reader
+	 * needs to know already, e.g. from the fields of a log stream.
+	 *
+	 * @param fmt The serialization format to use. The format handles
+	 * low-level I/O.
+	 *
+	 * @return False if an error occured.
+	 */
+	bool WriteUntyped(zeek::detail::SerializationFormat* fmt) const;
+
 	/**
 	 * Returns true if the type can be represented by a Value. If
 	 * `atomic_only` is true, will not permit composite types. This
@@ -228,6 +252,9 @@ struct Value {
 private:
 	friend class IPAddr;
 	Value(const Value& other) = delete;
+
+	bool ReadContent(zeek::detail::SerializationFormat* fmt, bool typed);
+	bool WriteContent(zeek::detail::SerializationFormat* fmt, bool typed) const;
 };
 
 } // namespace zeek::threading
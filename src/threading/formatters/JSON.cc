@@ -12,13 +12,231 @@
 #include <stdint.h>
 #include <sstream>
 
+#include <rapidjson/internal/dtoa.h>
 #include <rapidjson/internal/ieee754.h>
+#include <rapidjson/internal/itoa.h>
 
 #include "zeek/Desc.h"
+#include "zeek/ConvertUTF.h"
+#include "zeek/bro_inet_ntop.h"
 #include "zeek/threading/MsgThread.h"
 
 namespace zeek::threading::formatter {
 
+void JSONWriter::Int64(int64_t i)
+	{
+	Separate();
+	char buf[24];
+	char* end = rapidjson::internal::i64toa(i, buf);
+	buffer.append(buf, end - buf);
+	}
+
+void JSONWriter::Uint64(uint64_t u)
+	{
+	Separate();
+	char buf[24];
+	char* end = rapidjson::internal::u64toa(u, buf);
+	buffer.append(buf, end - buf);
+	}
+
+void JSONWriter::Double(double d)
+	{
+	if ( rapidjson::internal::Double(d).IsNanOrInf() )
+		{
+		Null();
+		return;
+		}
+
+	Separate();
+	char buf[32];
+	char* end = rapidjson::internal::dtoa(d, buf);
+	buffer.append(buf, end - buf);
+	}
+
+// The escape sequences for characters below 0x20 and for the two that
+// always need escaping, '"' and '\\'. Zero means no escaping.
+static constexpr char escapes[128] = {
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+	'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+	0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+	};
+
+static constexpr char hex_digits[] = "0123456789ABCDEF";
+
+void JSONWriter::AppendString(const char* s, size_t len)
+	{
+	buffer.reserve(buffer.size() + len + 2);
+	buffer += '"';
+
+	size_t start = 0;
+
+	for ( size_t i = 0; i < len; ++i )
+		{
+		auto c = static_cast<unsigned char>(s[i]);
+
+		if ( c >= 128 || ! escapes[c] )
+			continue;
+
+		buffer.append(s + start, i - start);
+		start = i + 1;
+
+		char esc[6] = {'\\', escapes[c]};
+
+		if ( esc[1] == 'u' )
+			{
+			esc[2] = '0';
+			esc[3] = '0';
+			esc[4] = hex_digits[c >> 4];
+			esc[5] = hex_digits[c & 0xf];
+			buffer.append(esc, 6);
+			}
+		else
+			buffer.append(esc, 2);
+		}
+
+	buffer.append(s + start, len - start);
+	buffer += '"';
+	}
+
+void JSONWriter::StringUTF8(const char* s, size_t len)
+	{
+	Separate();
+	buffer.reserve(buffer.size() + len + 2);
+	buffer += '"';
+
+	auto data = reinterpret_cast<const unsigned char*>(s);
+	size_t start = 0;
+	size_t i = 0;
+
+	while ( i < len )
+		{
+		auto c = data[i];
+
+		if ( c >= 128 )
+			{
+			unsigned int n = getNumBytesForUTF8(c);
+
+			if ( n > 0 && i + n <= len && isLegalUTF8Sequence(data + i, data + i + n) )
+				{
+				i += n;
+				continue;
+				}
+			}
+
+		else if ( ! escapes[c] )
+			{
+			++i;
+			continue;
+			}
+
+		buffer.append(s + start, i - start);
+		start = ++i;
+
+		if ( c >= 128 || escapes[c] == 'u' )
+			{
+			// Bytes that json_escape_utf8() turns into "\\xNN", of which
+			// the backslash then gets escaped itself.
+			char esc[5] = {'\\', '\\', 'x'};
+			util::bytetohex(c, esc + 3);
+			buffer.append(esc, 5);
+			}
+		else
+			{
+			char esc[2] = {'\\', escapes[c]};
+			buffer.append(esc, 2);
+			}
+		}
+
+	buffer.append(s + start, len - start);
+	buffer += '"';
+	}
+
+void JSONWriter::AppendAddr(const in_addr& a)
+	{
+	// The common case, without going through inet_ntop().
+	auto b = reinterpret_cast<const unsigned char*>(&a.s_addr);
+	char buf[INET_ADDRSTRLEN];
+	char* p = buf;
+
+	for ( int i = 0; i < 4; ++i )
+		{
+		if ( i > 0 )
+			*p++ = '.';
+
+		unsigned int v = b[i];
+
+		if ( v >= 100 )
+			{
+			*p++ = '0' + v / 100;
+			v %= 100;
+			*p++ = '0' + v / 10;
+			}
+		else if ( v >= 10 )
+			*p++ = '0' + v / 10;
+
+		*p++ = '0' + v % 10;
+		}
+
+	buffer.append(buf, p - buf);
+	}
+
+void JSONWriter::AppendAddr(const in6_addr& a)
+	{
+	char buf[INET6_ADDRSTRLEN];
+
+	if ( ! bro_inet_ntop(AF_INET6, &a, buf, sizeof(buf)) )
+		buffer += "<bad IPv6 address conversion>";
+	else
+		buffer += buf;
+	}
+
+void JSONWriter::Addr(const in_addr& a)
+	{
+	Separate();
+	buffer += '"';
+	AppendAddr(a);
+	buffer += '"';
+	}
+
+void JSONWriter::Addr(const in6_addr& a)
+	{
+	Separate();
+	buffer += '"';
+	AppendAddr(a);
+	buffer += '"';
+	}
+
+void JSONWriter::Subnet(const in_addr& a, int len)
+	{
+	Separate();
+	buffer += '"';
+	AppendAddr(a);
+	buffer += '/';
+	buffer += std::to_string(len);
+	buffer += '"';
+	}
+
+void JSONWriter::Subnet(const in6_addr& a, int len)
+	{
+	Separate();
+	buffer += '"';
+	AppendAddr(a);
+	buffer += '/';
+	buffer += std::to_string(len);
+	buffer += '"';
+	}
+
+std::string JSONWriter::EscapedKey(const std::string& name)
+	{
+	JSONWriter w;
+	w.AppendString(name.data(), name.size());
+	w.buffer += ':';
+	return w.buffer;
+	}
+
 bool JSON::NullDoubleWriter::Double(double d)
 	{
 	if ( rapidjson::internal::Double(d).IsNanOrInf() )
@@ -39,19 +257,31 @@ JSON::~JSON()
 bool JSON::Describe(ODesc* desc, int num_fields, const Field* const * fields,
                     Value** vals) const
 	{
-	rapidjson::StringBuffer buffer;
-	NullDoubleWriter writer(buffer);
+	if ( fields != escaped_fields || escaped_keys.size() != static_cast<size_t>(num_fields) )
+		{
+		// A writer keeps its fields, so this only happens once per json.
+		escaped_keys.clear();
+
+		for ( int i = 0; i < num_fields; i++ )
+			escaped_keys.emplace_back(JSONWriter::EscapedKey(fields[i]->name));
+
+		escaped_fields = fields;
+		}
 
-	writer.StartObject();
+	json.Clear();
+	json.StartObject();
 
 	for ( int i = 0; i < num_fields; i++ )
 		{
 		if ( vals[i]->present )
-			BuildJSON(writer, vals[i], fields[i]->name);
+			{
+			json.RawKey(escaped_keys[i]);
+			BuildJSON(json, vals[i]);
+			}
 		}
 
-	writer.EndObject();
-	desc->Add(buffer.GetString());
+	json.EndObject();
+	desc->AddN(json.Data(), json.Len());
 
 	return true;
 	}
@@ -67,15 +297,12 @@ bool JSON::Describe(ODesc* desc, Value* val, const std::string& name) const
 	if ( ! val->present || name.empty() )
 		return true;
 
-	rapidjson::Document doc;
-	rapidjson::StringBuffer buffer;
-	NullDoubleWriter writer(buffer);
+	json.Clear();
+	json.StartObject();
+	BuildJSON(json, val, name);
+	json.EndObject();
 
-	writer.StartObject();
-	BuildJSON(writer, val, name);
-	writer.EndObject();
-
-	desc->Add(buffer.GetString());
+	desc->AddN(json.Data(), json.Len());
 	return true;
 	}
 
@@ -86,7 +313,7 @@ Value* JSON::ParseValue(const std::string& s, const std::string& name,
 	return nullptr;
 	}
 
-void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& name) const
+void JSON::BuildJSON(JSONWriter& writer, Value* val, const std::string& name) const
 	{
 	if ( ! val->present )
 		{
@@ -116,12 +343,28 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 			break;
 
 		case TYPE_SUBNET:
-			writer.String(Formatter::Render(val->val.subnet_val));
+			{
+			const auto& sn = val->val.subnet_val;
+
+			if ( sn.prefix.family == IPv4 )
+				writer.Subnet(sn.prefix.in.in4, sn.length - 96);
+			else
+				writer.Subnet(sn.prefix.in.in6, sn.length);
+
 			break;
+			}
 
 		case TYPE_ADDR:
-			writer.String(Formatter::Render(val->val.addr_val));
+			{
+			const auto& a = val->val.addr_val;
+
+			if ( a.family == IPv4 )
+				writer.Addr(a.in.in4);
+			else
+				writer.Addr(a.in.in6);
+
 			break;
+			}
 
 		case TYPE_DOUBLE:
 		case TYPE_INTERVAL:
@@ -175,8 +418,7 @@ void JSON::BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& na
 		case TYPE_FILE:
 		case TYPE_FUNC:
 			{
-			writer.String(util::json_escape_utf8(
-				              std::string(val->val.string_val.data, val->val.string_val.length)));
+			writer.StringUTF8(val->val.string_val.data, val->val.string_val.length);
 			break;
 			}
 
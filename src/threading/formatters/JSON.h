@@ -6,13 +6,126 @@
 #include <rapidjson/document.h>
 #include <rapidjson/writer.h>
 
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
 #include "zeek/threading/Formatter.h"
 
 namespace zeek::threading::formatter {
 
 /**
-  * A thread-safe class for converting values into a JSON representation
-  * and vice versa.
+ * A streaming JSON encoder that appends compact JSON to a buffer, which
+ * can be reused across documents to avoid allocations. It produces the
+ * same output as rapidjson's writer with JSON::NullDoubleWriter, i.e.,
+ * NaN and infinite doubles become null.
+ */
+class JSONWriter {
+public:
+	/**
+	 * Empties the buffer for the next document, keeping its memory.
+	 */
+	void Clear()	{ buffer.clear(); levels.clear(); after_key = false; }
+
+	/**
+	 * Empties the buffer and releases its memory.
+	 */
+	void Reset()	{ std::string().swap(buffer); levels.clear(); after_key = false; }
+
+	/**
+	 * Returns the amount of memory the buffer currently holds on to.
+	 */
+	size_t Capacity() const	{ return buffer.capacity(); }
+
+	const char* Data() const	{ return buffer.data(); }
+	size_t Len() const	{ return buffer.size(); }
+	const std::string& Str() const	{ return buffer; }
+
+	void StartObject()	{ Start('{'); }
+	void EndObject()	{ End('}'); }
+	void StartArray()	{ Start('['); }
+	void EndArray()	{ End(']'); }
+
+	/**
+	 * Adds an object key, escaping it as needed.
+	 */
+	void Key(const char* s, size_t len)	{ Separate(); AppendString(s, len); buffer += ':'; after_key = true; }
+	void Key(const std::string& s)	{ Key(s.data(), s.size()); }
+
+	/**
+	 * Adds an object key given as a precomputed, already escaped,
+	 * quoted name followed by a colon. See EscapedKey().
+	 */
+	void RawKey(const std::string& key)	{ Separate(); buffer += key; after_key = true; }
+
+	void Null()	{ Separate(); buffer.append("null", 4); }
+	void Bool(bool b)	{ Separate(); b ? buffer.append("true", 4) : buffer.append("false", 5); }
+	void Int64(int64_t i);
+	void Uint64(uint64_t u);
+	void Double(double d);
+
+	/**
+	 * Adds a string, escaping it for JSON.
+	 */
+	void String(const char* s, size_t len)	{ Separate(); AppendString(s, len); }
+	void String(const std::string& s)	{ String(s.data(), s.size()); }
+
+	/**
+	 * Adds a string that may not be valid UTF-8. Like passing the result
+	 * of util::json_escape_utf8() to String(), but in a single pass.
+	 */
+	void StringUTF8(const char* s, size_t len);
+
+	/**
+	 * Adds an address as a string.
+	 */
+	void Addr(const in_addr& a);
+	void Addr(const in6_addr& a);
+
+	/**
+	 * Adds a subnet as a string, with a prefix length relative to the
+	 * address family.
+	 */
+	void Subnet(const in_addr& a, int len);
+	void Subnet(const in6_addr& a, int len);
+
+	/**
+	 * Returns a key in the form RawKey() expects.
+	 */
+	static std::string EscapedKey(const std::string& name);
+
+private:
+	void Start(char c)	{ Separate(); buffer += c; levels.push_back(false); }
+	void End(char c)	{ buffer += c; levels.pop_back(); }
+
+	// Adds a comma unless this is the first element of an object or
+	// array, or a value following its key.
+	void Separate()
+		{
+		if ( after_key )
+			after_key = false;
+		else if ( ! levels.empty() )
+			{
+			if ( levels.back() )
+				buffer += ',';
+			else
+				levels.back() = true;
+			}
+		}
+
+	void AppendString(const char* s, size_t len);
+	void AppendAddr(const in_addr& a);
+	void AppendAddr(const in6_addr& a);
+
+	std::string buffer;
+	std::vector<bool> levels; // Per nesting level, whether it has elements.
+	bool after_key = false;
+};
+
+/**
+  * A class for converting values into a JSON representation and vice
+  * versa. An instance reuses scratch state across calls, so it must only be
+  * used by a single thread at a time, normally the MsgThread it belongs to.
   */
 class JSON : public Formatter {
 public:
@@ -38,10 +151,17 @@ public:
 	};
 
 private:
-	void BuildJSON(NullDoubleWriter& writer, Value* val, const std::string& name = "") const;
+	void BuildJSON(JSONWriter& writer, Value* val, const std::string& name = "") const;
 
 	TimeFormat timestamps;
 	bool surrounding_braces;
+
+	// Reused across records, like the escaped keys of the fields that
+	// escaped_fields points to. This is what makes the class unsafe to
+	// share between threads.
+	mutable JSONWriter json;
+	mutable const Field* const * escaped_fields = nullptr;
+	mutable std::vector<std::string> escaped_keys;
 };
 
 } // namespace zeek::threading::formatter
@@ -41,12 +41,14 @@
 #include "zeek/EventRegistry.h"
 #include "zeek/Stats.h"
 #include "zeek/ScriptCoverageManager.h"
+#include "zeek/SamplingProfiler.h"
 #include "zeek/Traverse.h"
 #include "zeek/Trigger.h"
 #include "zeek/Hash.h"
 #include "zeek/Func.h"
 #include "zeek/ScannedFile.h"
 #include "zeek/Frag.h"
+#include "zeek/ShuntTable.h"
 
 #include "zeek/script_opt/ScriptOpt.h"
 
@@ -112,8 +114,10 @@ zeek::EventRegistry* zeek::event_registry = nullptr;
 zeek::detail::ProfileLogger* zeek::detail::profiling_logger = nullptr;
 zeek::detail::ProfileLogger* zeek::detail::segment_logger = nullptr;
 zeek::detail::SampleLogger* zeek::detail::sample_logger = nullptr;
+zeek::detail::CoreMetrics* zeek::detail::core_metrics = nullptr;
 
 zeek::detail::FragmentManager* zeek::detail::fragment_mgr = nullptr;
+zeek::detail::ShuntTable* zeek::detail::shunt_table = nullptr;
 
 int signal_val = 0;
 extern char version[];
@@ -310,11 +314,17 @@ static void terminate_bro()
 		delete profiling_logger;
 		}
 
+	delete core_metrics;
+
+	if ( sampling_profiler.IsRunning() )
+		sampling_profiler.Stop();
+
 	event_mgr.Drain();
 
 	notifier::detail::registry.Terminate();
 	log_mgr->Terminate();
 	input_mgr->Terminate();
+	iosource_mgr->ClosePktDumpers();
 	thread_mgr->Terminate();
 	broker_mgr->Terminate();
 	dns_mgr->Terminate();
@@ -335,6 +345,7 @@ static void terminate_bro()
 	delete plugin_mgr;
 	delete val_mgr;
 	delete fragment_mgr;
+	delete shunt_table;
 	delete telemetry_mgr;
 
 	// free the global scope
@@ -477,6 +488,7 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	thread_mgr = new threading::Manager();
 	plugin_mgr = new plugin::Manager();
 	fragment_mgr = new detail::FragmentManager();
+	shunt_table = new detail::ShuntTable();
 
 #ifdef DEBUG
 	if ( options.debug_log_streams )
@@ -498,6 +510,12 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 		supervisor_mgr = new Supervisor(std::move(cfg), std::move(*stem));
 		}
 
+	if ( const char* hash_function = getenv("ZEEK_INTERNAL_HASH") )
+		{
+		if ( *hash_function && ! KeyedHash::SetHash64Function(hash_function) )
+			reporter->FatalError("unknown internal hash function '%s'", hash_function);
+		}
+
 	const char* seed_load_file = getenv("ZEEK_SEED_FILE");
 
 	if ( options.random_seed_input_file )
@@ -799,6 +817,8 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 	if ( (oldhandler = setsignal(SIGHUP, sig_handler)) != SIG_DFL )
 		(void) setsignal(SIGHUP, oldhandler);
 
+	sampling_profiler.InstallToggleSignal();
+
 	if ( dns_type == DNS_PRIME )
 		{
 		dns_mgr->Verify();
@@ -838,6 +858,9 @@ SetupResult setup(int argc, char** argv, Options* zopts)
 			segment_logger = profiling_logger;
 		}
 
+	if ( core_metrics_interval > 0 )
+		core_metrics = new CoreMetrics(core_metrics_interval);
+
 	if ( ! run_state::reading_live && ! run_state::reading_traces )
 		// Set up network_time to track real-time, since
 		// we don't have any other source for it.